@@ -0,0 +1,124 @@
+#!/usr/bin/env python
+# BSDL boundary-scan descriptions, and VCD output for captured samples
+
+import re, time
+
+class BSDL:
+
+    """The parts of a BSDL file needed to sample pins: IR length and
+    opcodes, IDCODE, and the boundary register's cells.
+
+    cells holds (number, cell, port, function, safe) tuples, with cell
+    0 nearest TDO."""
+
+    def __init__(self, text):
+        # comments run from -- to the end of the line
+        self.text = re.sub(r"--[^\n]*", "", text)
+        self.entity = re.search(r"\bentity\s+(\w+)\s+is", self.text, re.I).group(1)
+        self.irlen = int(self.attribute("INSTRUCTION_LENGTH"))
+        self.bsrlen = int(self.attribute("BOUNDARY_LENGTH"))
+
+        self.opcodes = {}
+        for name, codes in re.findall(r"(\w+)\s*\(([01xX,\s]+)\)",
+                                      self.attribute("INSTRUCTION_OPCODE")):
+            self.opcodes[name.upper()] = [c.strip() for c in codes.split(",")]
+
+        self.idcode = None
+        idcode = self.attribute("IDCODE_REGISTER")
+        if idcode:
+            self.idcode = idcode.replace(" ", "")
+
+        self.cells = []
+        for num, fields in re.findall(r"(\d+)\s*\(([^()]*(?:\([^()]*\)[^()]*)*)\)",
+                                      self.attribute("BOUNDARY_REGISTER")):
+            f = [x.strip() for x in fields.split(",")]
+            self.cells.append((int(num), f[0], f[1], f[2].lower(), f[3]))
+        self.cells.sort()
+
+    def attribute(self, name):
+        """The value of an attribute, with its strings concatenated."""
+        m = re.search(r"attribute\s+%s\s+of\s+\w+\s*:\s*\w+\s+is\s+(.*?);" % name,
+                      self.text, re.I | re.S)
+        if not m:
+            return None
+        value = m.group(1)
+        strings = re.findall(r'"([^"]*)"', value)
+        if strings:
+            return "".join(strings)
+        return value.strip()
+
+    def opcode(self, name):
+        """An instruction's opcode as an integer, with don't-cares as 0."""
+        code = self.opcodes[name.upper()][0]
+        return int(code.replace("x", "0").replace("X", "0"), 2)
+
+    def sample_opcode(self):
+        for name in ("SAMPLE", "SAMPLE/PRELOAD", "PRELOAD"):
+            if name in self.opcodes:
+                return self.opcode(name)
+        raise Exception("%s has no SAMPLE instruction" % self.entity)
+
+    def pins(self):
+        """Map each port to the cell that best shows its pin: an input,
+        bidir or observe-only cell, or else an output cell."""
+        best = {}
+        rank = {"input": 0, "clock": 0, "observe_only": 0, "bidir": 0,
+                "output3": 1, "output2": 1}
+        for num, cell, port, function, safe in self.cells:
+            if port == "*" or function not in rank:
+                continue
+            if port not in best or rank[function] < best[port][0]:
+                best[port] = (rank[function], num)
+        pins = [(num, port) for port, (r, num) in best.items()]
+        pins.sort()
+        return pins
+
+
+def bit(sample, cell):
+    """A cell's value from a sample of bytes, cell 0 in byte 0's LSB."""
+    return (sample[cell >> 3] >> (cell & 7)) & 1
+
+
+class VCDWriter:
+
+    """Writes boundary-scan samples as a VCD, one wire per pin."""
+
+    def __init__(self, f, pins, module="bscan", timescale="1 us"):
+        self.f = f
+        self.pins = pins
+        self.ids = {}
+        self.last = {}
+        f.write("$date %s $end\n" % time.ctime())
+        f.write("$version GoodFET boundary scan $end\n")
+        f.write("$timescale %s $end\n" % timescale)
+        f.write("$scope module %s $end\n" % module)
+        for i, (cell, port) in enumerate(pins):
+            ident = self.ident(i)
+            self.ids[cell] = ident
+            name = re.sub(r"[^\w]", "_", port).strip("_")
+            f.write("$var wire 1 %s %s $end\n" % (ident, name))
+        f.write("$upscope $end\n$enddefinitions $end\n")
+
+    def ident(self, n):
+        """Short printable VCD identifier for wire n."""
+        s = ""
+        while True:
+            s += chr(33 + n % 94)
+            n = n / 94
+            if not n:
+                return s
+
+    def sample(self, t, sample):
+        """Record a sample at time t, writing only the pins that changed."""
+        changes = []
+        for cell, port in self.pins:
+            v = bit(sample, cell)
+            if self.last.get(cell) != v:
+                changes.append("%d%s" % (v, self.ids[cell]))
+                self.last[cell] = v
+        if changes:
+            self.f.write("#%d\n%s\n" % (t, "\n".join(changes)))
+
+    def close(self, t):
+        self.f.write("#%d\n" % t)
+        self.f.close()
@@ -39,6 +39,27 @@ CHAIN0 =                0x93
 SCANCHAIN1 =            0x94
 EICE_READ =             0x95
 EICE_WRITE =            0x96
+# ADIv5 DP/AP access, done on the GoodFET
+DP_READ =               0x90
+DP_WRITE =              0x91
+AP_READ =               0x92
+AP_WRITE =              0x93
+MEM_READ_BLOCK =        0x94
+MEM_WRITE_BLOCK =       0x95
+
+READ_BLOCK_DWORDS =     0x100
+WRITE_BLOCK_DWORDS =    0x3e      # ap and adr must fit in the smallest CMDDATALEN too
+
+# SWD app
+SWD_APP =               0x19
+SWD_LINE_RESET =        0x90
+SWD_TRANSFER =          0x91
+SWD_REQ_APnDP =         0x01
+SWD_REQ_RnW =           0x02
+SWD_ACK_OK =            0x1
+SWD_ACK_NAMES = {1:"OK", 2:"WAIT", 4:"FAULT", 7:"NO RESPONSE", 8:"PARITY"}
+SWD_READ_BLOCK_DWORDS = 0xf0      # one request byte per word
+SWD_WRITE_BLOCK_DWORDS = 0x30     # five request bytes per word
 
 #4-bit ARM JTAG INSTRUCTIONS - STANDARD
 IR_ABORT =              0x8
@@ -268,6 +289,56 @@ class GoodFETADIv5(GoodFET):
             self.aps = [createAP(self, x) for x in xrange(MAX_AP_COUNT)]
         return self.aps
 
+    ####### DP/AP access on the GoodFET #######
+    def ADIgetDP(self, addr):
+        self.writecmd(0x14,DP_READ,1,[addr])
+        return struct.unpack("<L", self.data[:4])[0]
+    def ADIsetDP(self, addr, val):
+        data = [addr,0,0,0]
+        data.extend(chop(val,4))
+        self.writecmd(0x14,DP_WRITE,len(data),data)
+    def ADIgetAP(self, apnum, addr):
+        self.writecmd(0x14,AP_READ,2,[apnum,addr])
+        return struct.unpack("<L", self.data[:4])[0]
+    def ADIsetAP(self, apnum, addr, val):
+        data = [apnum,addr,0,0]
+        data.extend(chop(val,4))
+        self.writecmd(0x14,AP_WRITE,len(data),data)
+
+    def ADIreadBlock(self, apnum, adr, wordcount):
+        """ MEM-AP read.  The GoodFET sets CSW/TAR once per 1KiB and pipelines DRW, returning READ_BLOCK_DWORDS per reply.
+        WARNING: Addresses must be word-aligned!
+        """
+        while (wordcount > 0):
+            count = min(wordcount, READ_BLOCK_DWORDS)
+            data = [apnum,0,0,0]
+            data.extend(chop(adr,4))
+            data.extend(chop(count,2))
+            self.writecmd(0x14,MEM_READ_BLOCK,len(data),data)
+            words = struct.unpack("<%dL" % (len(self.data)/4), self.data)
+            if words[-1] & STICKYERR:
+                raise Exception("MEM-AP fault reading 0x%x-0x%x" % (adr, adr+count*4))
+            for dword in words[:-1]:
+                yield dword
+            wordcount -= count
+            adr += count*4
+
+    def ADIwriteBlock(self, apnum, adr, wordarray):
+        """ MEM-AP write, WRITE_BLOCK_DWORDS per command.
+        WARNING: Addresses must be word-aligned!
+        """
+        while (len(wordarray) > 0):
+            count = min(len(wordarray), WRITE_BLOCK_DWORDS)
+            data = [apnum,0,0,0]
+            data.extend(chop(adr,4))
+            for word in wordarray[:count]:
+                data.extend(chop(word,4))
+            self.writecmd(0x14,MEM_WRITE_BLOCK,len(data),data)
+            if struct.unpack("<L", self.data[:4])[0] & STICKYERR:
+                raise Exception("MEM-AP fault writing 0x%x-0x%x" % (adr, adr+count*4))
+            wordarray = wordarray[count:]
+            adr += count*4
+
     def ADIgetWCR(self):        # SWDP only
         raise Exception("IMPLEMENT ME: ADIgetWCR")
 
@@ -352,11 +423,102 @@ class GoodFETADIjtag(GoodFETADIv5):
             return self.ADIgetDPACC(0x8)
         return self.ap_selected
 
+class GoodFETADIswd(GoodFETADIv5):
+    """ADIv5 over Serial Wire Debug.  DP/AP accesses are packed into one SWD_TRANSFER per round trip."""
+    def setup(self):
+        self.writecmd(SWD_APP,SETUP,0,self.data)
+    def start(self):
+        self.ADIident()
+    def ADIident(self):
+        """Line reset into SWD and read the DP IDCODE."""
+        self.writecmd(SWD_APP,START,0,self.data)
+        if self.verb != START:
+            raise Exception("No response to SWD line reset")
+        self.ap_selected = None
+        return struct.unpack("<L", self.data[:4])[0]
+
+    def ADIswdTransfer(self, reqs):
+        """ reqs is a list of (request, value) pairs, value being ignored for reads.
+        request is APnDP | RnW<<1 | addr&0xc.  Returns the values read, in order.
+        """
+        data = []
+        for req, val in reqs:
+            data.append(req)
+            if not req & SWD_REQ_RnW:
+                data.extend(chop(val,4))
+        self.writecmd(SWD_APP,SWD_TRANSFER,len(data),data)
+        words = struct.unpack("<%dL" % (len(self.data)/4), self.data)
+        status = words[-1]
+        if (status & 0xff) != SWD_ACK_OK:
+            self.ap_selected = None
+            ack = status & 0xff
+            raise Exception("SWD transfer %d of %d failed: %s" % (status>>16, len(reqs), SWD_ACK_NAMES.get(ack, hex(ack))))
+        return list(words[:-1])
+
+    def _dp(self, addr, val=None):
+        if val == None:
+            return (SWD_REQ_RnW | (addr&0xc), 0)
+        return (addr&0xc, val)
+    def _ap(self, addr, val=None):
+        if val == None:
+            return (SWD_REQ_APnDP | SWD_REQ_RnW | (addr&0xc), 0)
+        return (SWD_REQ_APnDP | (addr&0xc), val)
+    def _select(self, apnum, addr):
+        """ SELECT write needed before an AP access, if any. """
+        bank = addr & 0xf0
+        if (apnum, bank) == (self.ap_selected, self.ap_bank):
+            return []
+        self.ap_selected = apnum
+        self.ap_bank = bank
+        return [self._dp(DP_SELECT_OFF, (apnum<<24) | bank)]
+
+    def ADIgetDP(self, addr):
+        return self.ADIswdTransfer([self._dp(addr)])[0]
+    def ADIsetDP(self, addr, val):
+        if addr == DP_SELECT_OFF:
+            self.ap_selected = None
+        self.ADIswdTransfer([self._dp(addr, val)])
+    def ADIgetAP(self, apnum, addr):
+        return self.ADIswdTransfer(self._select(apnum, addr) + [self._ap(addr)])[0]
+    def ADIsetAP(self, apnum, addr, val):
+        self.ADIswdTransfer(self._select(apnum, addr) + [self._ap(addr, val)])
+
+    def _memsetup(self, apnum):
+        csw = self.ADIgetAP(apnum, ADI_MEM_AP.MEMAP_CSW_REG)
+        csw = (csw & ~0x3f) | 0x12                  # 32-bit, single auto-increment
+        self.ADIsetAP(apnum, ADI_MEM_AP.MEMAP_CSW_REG, csw)
+    def _memchunk(self, adr, wordcount, maxwords):
+        return min(wordcount, maxwords, (0x400 - (adr & 0x3ff))/4)
+
+    def ADIreadBlock(self, apnum, adr, wordcount):
+        """ MEM-AP read: TAR write then a run of DRW reads, pipelined on the GoodFET.
+        WARNING: Addresses must be word-aligned!
+        """
+        self._memsetup(apnum)
+        while (wordcount > 0):
+            count = self._memchunk(adr, wordcount, SWD_READ_BLOCK_DWORDS)
+            reqs = [self._ap(ADI_MEM_AP.MEMAP_TAR_REG, adr)]
+            reqs.extend([self._ap(ADI_MEM_AP.MEMAP_DRW_REG)] * count)
+            for dword in self.ADIswdTransfer(reqs):
+                yield dword
+            wordcount -= count
+            adr += count*4
+
+    def ADIwriteBlock(self, apnum, adr, wordarray):
+        """ MEM-AP write: TAR write then a run of DRW writes.
+        WARNING: Addresses must be word-aligned!
+        """
+        self._memsetup(apnum)
+        while (len(wordarray) > 0):
+            count = self._memchunk(adr, len(wordarray), SWD_WRITE_BLOCK_DWORDS)
+            reqs = [self._ap(ADI_MEM_AP.MEMAP_TAR_REG, adr)]
+            reqs.extend([self._ap(ADI_MEM_AP.MEMAP_DRW_REG, word) for word in wordarray[:count]])
+            self.ADIswdTransfer(reqs)
+            wordarray = wordarray[count:]
+            adr += count*4
+
 def createAP(dp, apnum):
-    idr = 0xfc
-    bank = idr/16
-    self.dp.ADIsetSELECT(self.apnum, bank)
-    ident = self.dp.ADIgetAPACC(idr&0xf)
+    ident = dp.ADIgetAP(apnum, 0xfc)
     if ((ident>>16)&1):
         return ADI_MEM_AP(dp, apnum)
     return ADI_JTAG_AP(dp, apnum)
@@ -366,14 +528,11 @@ class ADI_AccessPort:           # define common AP calls
         self.dp = DP            # link to parent.  all calls should use this to access the underlying debug port.
         self.apnum = apnum      # which AP am i to this DP?
 
-    def getRegister(self, bank, off):
-        self.dp.ADIsetSELECT(self.apnum, bank)
-        return self.dp.ADIgetAPACC(off)
-
-    def getRegisterByAddr(self, addr):
-        bank = addr/16
-        self.dp.ADIsetSELECT(self.apnum, bank)
-        return self.dp.ADIgetAPACC(addr&0xf)
+    def getRegister(self, addr):
+        return self.dp.ADIgetAP(self.apnum, addr)
+    def setRegister(self, addr, val):
+        return self.dp.ADIsetAP(self.apnum, addr, val)
+    getRegisterByAddr = getRegister
 
     def getIdentRegister(self):
         ident = self.getRegisterByAddr(0xfc)
@@ -405,7 +564,7 @@ class ADI_MEM_AP(ADI_AccessPort):
         ADI_AccessPort.__init__(self, DP, apnum)
         self.cfg = self.getCFG()                    # necessary to cache endianness information
         # FIXME: how do i determine if this adi supports multibyte access or just word?  or packed transfers?
-        self.setMemAccessSize(4)
+        self.CSWsetMemAccessSize(4)
 
     def getCSW(self):
         """ Control/Status Word reg  """
@@ -431,6 +590,13 @@ class ADI_MEM_AP(ADI_AccessPort):
         """ Data Read/Write reg. """
         return self.setRegister(self.MEMAP_DRW_REG, drw)
 
+    def readBlock(self, adr, wordcount):
+        """ TAR auto-increment read, done on the GoodFET.  Generator of words. """
+        return self.dp.ADIreadBlock(self.apnum, adr, wordcount)
+    def writeBlock(self, adr, wordarray):
+        """ TAR auto-increment write, done on the GoodFET. """
+        self.dp.ADIwriteBlock(self.apnum, adr, wordarray)
+
     #FIXME: use one set of accessors... either keep the indexed version or the individuals.
     def getBDReg(self, index):
         return self.getRegister(self.MEMAP_BD0_REG + (index*4))
@@ -505,7 +671,7 @@ class ADI_MEM_AP(ADI_AccessPort):
     def CSWsetAddrInc(self, bits=CFG_ADDRINC_single):
         cfg = (self.getCFG() & self.CFG_ADDRINC) >> self.CFG_ADDRINC_BITS
         cfg |= (bit<<self.CFG_DBGSWENABLE_BITS)
-    def CSWsetMemAccessSize(self, bytecount=self.CSW_MEM_32bits):        # 0b010 == 32bit words, necessary if the implementation allows for variable sizes
+    def CSWsetMemAccessSize(self, bytecount=4):        # 0b010 == 32bit words, necessary if the implementation allows for variable sizes
         csw = self.getCSW()
         csw &= 0xfffffff8
         csw |= (bytecount>>1)
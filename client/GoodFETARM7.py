@@ -45,6 +45,16 @@ CHAIN0 =                    0x93
 SCANCHAIN1 =                0x94
 EICE_READ =                 0x95
 EICE_WRITE =                0x96
+READ_BLOCK =                0x97
+WRITE_BLOCK =               0x98
+GET_REGISTERS =             0x99
+SET_REGISTERS =             0x9a
+DCC_LOAD_STUB =             0xa0
+DCC_WRITE =                 0xa1
+TRACE_START =               0xa2
+TRACE_RUN =                 0xa3
+TRACE_READ =                0xa4
+TRACE_STOP =                0xa5
 SCAN_N_SIZE =               0x9e
 IR_SIZE =                   0x9f
 
@@ -187,6 +197,11 @@ DBGCTRLBITS = {
         }
 
 LDM_BITMASKS = [(1<<x)-1 for x in xrange(16)]
+READ_BLOCK_DWORDS =         0x100     # dwords per READ_BLOCK reply (1kB)
+WRITE_BLOCK_DWORDS =        0x40      # dwords per WRITE_BLOCK command, fits the smallest cmddata buffer
+TRACE_BATCH =               0x20      # hits per TRACE_RUN, the depth of the FET's ring
+WP_DATA =                   0x008     # watchpoint control: nOPC, a data access
+WP_DATAMASK =               0xf7      # ...and nothing else matters
 #### TOTALLY BROKEN, NEED VALIDATION AND TESTING
 PCOFF_DBGRQ = 4 * 4
 PCOFF_WATCH = 4 * 4
@@ -244,13 +259,12 @@ class GoodFETARM7(GoodFET):
 
         h = IntelHex(None);
         i=start;
-        while i<=stop:
-            data=self.ARMreadChunk(i, 48, verbose=0);
-            print "Dumped %06x."%i;
-            for dword in data:
-                if i<=stop and dword != 0xdeadbeef:
-                    h.puts( i, struct.pack("<I", dword) )
-                i+=4;
+        for dword in self.ARMreadChunk(start, ((stop-start)/4)+1, verbose=0):
+            if i%0x1000 == 0:
+                print "Dumped %06x."%i;
+            if dword != 0xdeadbeef:
+                h.puts( i, struct.pack("<I", dword) )
+            i+=4;
         # FIXME: get mcu state and return it to that state
         self.resume()
         h.write_hex_file(fn);
@@ -389,17 +403,35 @@ class GoodFETARM7(GoodFET):
         retval = struct.unpack("<L", "".join(self.data[0:4]))[0]
         return retval
 
+    def ARMget_context(self):
+        """Get r0-r15 and CPSR in a single command.  CPSR reads as 0 in Thumb state."""
+        self.writecmd(0x13,GET_REGISTERS,0,[])
+        return list(struct.unpack("<17L", self.data[:68]))
+
+    def ARMset_context(self, regs, cpsr=None):
+        """Set r0-r14, and CPSR if given, in a single command.  PC is left to ARMsetPC."""
+        bulk = []
+        for reg in regs[:15]:
+            bulk.extend(chop(reg,4))
+        if cpsr != None:
+            bulk.extend(chop(cpsr,4))
+        self.writecmd(0x13,SET_REGISTERS,len(bulk),bulk)
+
     def ARMget_registers(self):
         """Get ARM Registers"""
-        regs = [ self.ARMget_register(x) for x in range(15) ]
+        regs = self.ARMget_context()[:15]
         regs.append(self.ARMgetPC())            # make sure we snag the "static" version of PC
         return regs
 
     def ARMset_registers(self, regs, mask):
         """Set ARM Registers"""
-        for x in xrange(15):
-          if (1<<x) & mask:
-            self.ARMset_register(x,regs.pop(0))
+        if (mask & 0x7fff) == 0x7fff:
+          self.ARMset_context(regs[:15])
+          regs[:15] = []
+        else:
+          for x in xrange(15):
+            if (1<<x) & mask:
+              self.ARMset_register(x,regs.pop(0))
         if (1<<15) & mask:                      # make sure we set the "static" version of PC or changes will be lost
           self.ARMsetPC(regs.pop(0))
 
@@ -437,6 +469,55 @@ class GoodFETARM7(GoodFET):
         self.ARMeice_write(EICE_WP1CTRLMASK, ctrlmask);   # write 0xfffffff7 in watchpoint 1 control mask - only detect the fetch instruction
         return self.data
 
+    def ARMtrace_start(self, addr, addrmask=0, ctrl=WP_DATA, ctrlmask=WP_DATAMASK):
+        """Arm watchpoint 0 for tracing.  addrmask bits set to 1 are don't-cares, so a
+        power-of-two range is (base, size-1).  The default control pair catches data
+        reads and writes but not instruction fetches."""
+        bulk = chop(addr,4) + chop(addrmask,4) + chop(ctrl,4) + chop(ctrlmask,4)
+        bulk += chop(PCOFF_WATCH + 4, 4)
+        self.writecmd(0x13,TRACE_START,len(bulk),bulk)
+
+    def ARMtrace_run(self, hits, timeout=0xffff):
+        """Let the core run until hits accesses are logged, or a timeout passes without one.
+        Call halt() first.  The core is back in debug state afterwards.  Returns the number
+        of hits logged."""
+        self.writecmd(0x13,TRACE_RUN,4,chop(hits,2)+chop(timeout,2))
+        done, pad, self.storedPC = struct.unpack("<HHL", self.data[:8])
+        # the core ran, so what resume() would restore is stale
+        self.c0Data, self.flags, self.c0Addr = self.ARMchain0(0)
+        self.stored_regs = self.ARMget_registers()[:15]
+        return done
+
+    def ARMtrace_read(self):
+        """Drain the FET's trace ring.  Returns (records, lost), records being
+        (pc, address, data) tuples, oldest first."""
+        self.writecmd(0x13,TRACE_READ,0,[])
+        count, lost = struct.unpack("<HH", self.data[:4])
+        recs = [struct.unpack("<LLL", self.data[4+12*i:16+12*i]) for i in xrange(count)]
+        return recs, lost
+
+    def ARMtrace_stop(self):
+        self.writecmd(0x13,TRACE_STOP,0,[])
+
+    def ARMtrace(self, addr, addrmask=0, hits=0x1000, ctrl=WP_DATA, ctrlmask=WP_DATAMASK):
+        """Generator of (pc, address, data) for accesses to a watched range, draining the
+        ring between batches.  Halts the core, and leaves it halted after the last hit."""
+        self.halt()
+        self.ARMtrace_start(addr, addrmask, ctrl, ctrlmask)
+        try:
+            while hits > 0:
+                done = self.ARMtrace_run(min(hits, TRACE_BATCH))
+                recs, lost = self.ARMtrace_read()
+                if lost:
+                    print >>sys.stderr, "trace ring overran, %i hits lost" % lost
+                for rec in recs:
+                    yield rec
+                if done < min(hits, TRACE_BATCH):
+                    return
+                hits -= done
+        finally:
+            self.ARMtrace_stop()
+
     def THUMBgetPC(self):
         THUMB_INSTR_STR_R0_r0 =     0x60006000L
         THUMB_INSTR_MOV_R0_PC =     0x46b846b8L
@@ -640,27 +721,20 @@ class GoodFETARM7(GoodFET):
     def ARMreadChunk(self, adr, wordcount=1, verbose=True):
         """ Only works in ARM mode currently
         WARNING: Addresses must be word-aligned!
+        The GoodFET loops LDMIA on-device, returning READ_BLOCK_DWORDS per reply.
         """
         regs = self.ARMget_registers()
-        self.ARMset_registers([0xdeadbeef for x in xrange(14)], 0xe)
-        count = wordcount
         while (wordcount > 0):
-            if (verbose and wordcount%64 == 0):  sys.stderr.write(".")
-            count = (wordcount, 0xe)[wordcount>0xd]
-            bitmask = LDM_BITMASKS[count]
-            self.ARMset_register(14,adr)
-            self.ARM_nop(1)
-            self.ARMdebuginstr(ARM_INSTR_LDMIA_R14_r0_rx | bitmask ,0)
-            #FIXME: do we need the extra nop here?
-            self.ARMrestart()
-            self.ARMwaitDBG()
-            for x in range(count):
-                yield self.ARMget_register(x)
+            if (verbose):  sys.stderr.write(".")
+            count = min(wordcount, READ_BLOCK_DWORDS)
+            bulk = chop(adr,4)
+            bulk.extend(chop(count,4))
+            self.writecmd(0x13,READ_BLOCK,8,bulk)
+            for dword in struct.unpack("<%dL" % (len(self.data)/4), self.data):
+                yield dword
             wordcount -= count
             adr += count*4
-            #print hex(adr)
-        # FIXME: handle the rest of the wordcount here.
-        self.ARMset_registers(regs,0xe)
+        self.ARMset_registers(regs,0x7fff)
 
     ARMreadMem = ARMreadChunk
     peek = ARMreadMem
@@ -668,27 +742,64 @@ class GoodFETARM7(GoodFET):
     def ARMwriteChunk(self, adr, wordarray):         
         """ Only works in ARM mode currently
         WARNING: Addresses must be word-aligned!
+        The GoodFET loops STMIA on-device, taking WRITE_BLOCK_DWORDS per command.
         """
         regs = self.ARMget_registers()
-        wordcount = len(wordarray)
-        while (wordcount > 0):
-            if (wordcount%64 == 0):  sys.stderr.write(".")
-            count = (wordcount, 0xe)[wordcount>0xd]
-            bitmask = LDM_BITMASKS[count]
-            self.ARMset_register(14,adr)
-            #print len(wordarray),bin(bitmask)
-            self.ARMset_registers(wordarray[:count],bitmask)
-            self.ARM_nop(1)
-            self.ARMdebuginstr(ARM_INSTR_STMIA_R14_r0_rx | bitmask ,0)
-            #FIXME: do we need the extra nop here?
-            self.ARMrestart()
-            self.ARMwaitDBG()
+        while (len(wordarray) > 0):
+            if (len(wordarray)>WRITE_BLOCK_DWORDS):  sys.stderr.write(".")
+            count = min(len(wordarray), WRITE_BLOCK_DWORDS)
+            bulk = chop(adr,4)
+            for word in wordarray[:count]:
+                bulk.extend(chop(word,4))
+            self.writecmd(0x13,WRITE_BLOCK,len(bulk),bulk)
+            written, = struct.unpack("<L", self.data[:4])
+            if written != count:
+                raise Exception("Timeout writing 0x%x, target did not re-enter DEBUG mode" % (adr+(4*written)))
             wordarray = wordarray[count:]
-            wordcount -= count
             adr += count*4
-            #print hex(adr)
-        # FIXME: handle the rest of the wordcount here.
+        self.ARMset_registers(regs,0x7fff)
     ARMwriteMem = ARMwriteChunk
+
+    def ARMdccWriteChunk(self, adr, wordarray, stubadr):
+        """ Write a large block through the debug comms channel.
+        The GoodFET loads a download stub at stubadr, the target runs it, and
+        each word then costs one EmbeddedICE scan.  Call halt() first; the stub
+        must not overlap the destination.  Registers and PC are restored.
+        """
+        saved_regs = self.stored_regs[:]
+        saved_pc = self.storedPC
+        end = adr + 4*len(wordarray)
+        self.writecmd(0x13,DCC_LOAD_STUB,4,chop(stubadr,4))
+        if struct.unpack("<L", self.data[:4])[0] == 0:
+            raise Exception("Failed to load DCC stub at 0x%x" % stubadr)
+        # the stub takes its destination in r0 and word count in r1
+        self.stored_regs = saved_regs[:]
+        self.stored_regs[0] = adr
+        self.stored_regs[1] = len(wordarray)
+        self.ARMsetPC(stubadr)
+        self.resume()
+        try:
+            while (len(wordarray) > 0):
+                if (len(wordarray)>WRITE_BLOCK_DWORDS):  sys.stderr.write(".")
+                count = min(len(wordarray), WRITE_BLOCK_DWORDS)
+                bulk = []
+                for word in wordarray[:count]:
+                    bulk.extend(chop(word,4))
+                self.writecmd(0x13,DCC_WRITE,len(bulk),bulk)
+                if struct.unpack("<L", self.data[:4])[0] != count:
+                    raise Exception("DCC stub stopped taking data near 0x%x" % adr)
+                wordarray = wordarray[count:]
+                adr += count*4
+        finally:
+            # empty, so halt() captures the stub's own r0/r1 even if it already stopped
+            self.stored_regs = []
+            self.halt()
+            done_regs = self.stored_regs
+            self.stored_regs = saved_regs
+            self.storedPC = saved_pc
+        if done_regs[1] != 0 or done_regs[0] != end:
+            raise Exception("DCC stub stopped at 0x%x with %d words left, expected 0x%x"
+                            % (done_regs[0], done_regs[1], end))
         
     def ARMwriteStream(self, addr, datastr):
         #bytecount = len(datastr)
@@ -799,6 +910,7 @@ def arm7_syntax():
     print "%s poke 0x$adr 0x$val" % sys.argv[0]
     print "%s peek 0x$start [0x$stop]" % sys.argv[0]
     print "%s reset" % sys.argv[0]
+    print "%s trace 0x$adr [0x$mask [$hits]]" % sys.argv[0]
     sys.exit()
 
 def arm7_main():
@@ -839,14 +951,12 @@ def arm7_cli_handler(client, argv):
         try:
             h = IntelHex(None)
             i=start
-            while i<=stop:
-                #data=client.ARMreadMem(i, 48)
-                data=client.ARMreadChunk(i, 48, verbose=0)
-                print "Dumped %06x."%i
-                for dword in data:
-                    if i<=stop and dword != 0xdeadbeef:
-                        h.puts( i, struct.pack("<I", dword) )
-                    i+=4
+            for dword in client.ARMreadChunk(start, ((stop-start)/4)+1, verbose=0):
+                if i%0x1000 == 0:
+                    print "Dumped %06x."%i
+                if dword != 0xdeadbeef:
+                    h.puts( i, struct.pack("<I", dword) )
+                i+=4
             # FIXME: get mcu state and return it to that state
         except:
             print "Unknown error during read. Writing results to output file."
@@ -867,6 +977,19 @@ def arm7_cli_handler(client, argv):
 
         
     '''
+    if(sys.argv[1]=="trace"):
+        adr = int(sys.argv[2],16)
+        mask = 0
+        hits = 0x100
+        if(len(sys.argv)>3):
+            mask=int(sys.argv[3],16)
+        if(len(sys.argv)>4):
+            hits=int(sys.argv[4])
+        print "Tracing accesses to %08x mask %08x." % (adr,mask)
+        for pc, a, d in client.ARMtrace(adr, mask, hits):
+            print "pc=%08x adr=%08x data=%08x" % (pc, a, d)
+        client.resume()
+
     if(sys.argv[1]=="ivt"):
         client.halt()
         client.ARMprintChunk(0x0,0x20)
@@ -874,8 +997,10 @@ def arm7_cli_handler(client, argv):
 
     if(sys.argv[1]=="regs"):
         client.halt()
+        regs = client.ARMget_context()
         for i in range(0,16):
-            print "r%i=%04x" % (i,client.ARMget_register(i))
+            print "r%i=%04x" % (i,regs[i])
+        print "cpsr=%04x %s" % (regs[16], PSRdecode(regs[16]))
         client.resume()
 
     if(sys.argv[1]=="flash"):
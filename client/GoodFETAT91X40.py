@@ -173,6 +173,9 @@ ERASE_DATA = 0
 NB_REG =     13
 SIZE_DATA =  4
 
+#* Debug comms channel download stub, top of the smallest (8kB) internal SRAM before remap
+DCC_STUB_BASE =  0x301fc0
+
 #* Flash LV Send Data parameters
 SIZE_256_BYTES = 0x100
 PACKET_SIZE =64
@@ -493,6 +496,12 @@ class GoodFETAT91X40(GoodFETARM7):
         self.release()
         # FIXME: use DCC to upload the new firmware
 
+    def ARMloadRAM(self, addr, datastr):
+        """Load a string of bytes into target RAM through the debug comms channel."""
+        datastr += "\xff" * ((4 - len(datastr)%4) % 4)
+        words = list(struct.unpack("<%dL" % (len(datastr)/4), datastr))
+        self.ARMdccWriteChunk(addr, words, DCC_STUB_BASE)
+
     def clearFlash(self):
         pass
 
@@ -521,7 +530,7 @@ def at91x40_main():
 
 
 
-BLOCK_DWORDS = 48
+BLOCK_DWORDS = 0x100
 BLOCK_SIZE   = 4 * BLOCK_DWORDS
 def at91x40_cli_handler(client, argv):
 
@@ -676,6 +685,15 @@ def at91x40_cli_handler(client, argv):
 
 
 
+    if(argv[1]=="loadram"):
+        f = argv[2]
+        h = IntelHex(f)
+        start = h.minaddr() & 0xfffffffc
+        print "Loading %s into RAM at %06x through DCC." % (f, start)
+        client.halt()
+        client.ARMloadRAM(start, h.tobinstr(start, h.maxaddr()))
+        client.resume()
+
     if(argv[1]=="memorymap"):
         client.halt()
         print "=============================================="
@@ -633,6 +633,64 @@ class GoodFETCC(GoodFET):
         self.shellcodefile("rxpacket.ihx");
         len=self.peek8(0xFE00,"xdata");
         return self.peekblock(0xFE00,len+3,"data");
+    #Receive ring left in XDATA by rxring.ihx
+    RXRING=0xF400;
+    RXRINGSLOTS=0xF410;
+    RXRINGMAGIC=0xB5;
+    def hasshellcode(self,filename):
+        """Has a fragment of shellcode been built and installed?"""
+        path=__file__.replace("GoodFETCC.pyc","GoodFETCC.py").replace(
+            "GoodFETCC.py","shellcode/chipcon/cc1110/"+filename);
+        return os.path.exists(path);
+    def RF_rxring(self):
+        """Start the radio receiving into a ring buffer in XDATA.
+        Returns False if rxring.ihx hasn't been built."""
+        if not self.hasshellcode("rxring.ihx"):
+            return False;
+        self.CChaltcpu();
+        self.shellcodefile("rxring.ihx",wait=0,alwaysreload=1);
+        return True;
+    def RF_simpliciti_ap(self,addr=[0x78,0x56,0x34,0x10],
+                         linktoken=[0x20,0x00,0xad,0xde],
+                         jointoken=[0xef,0xbe,0xad,0xde]):
+        """Answer SimpliciTI LINK and JOIN requests on the target,
+        logging packets to the receive ring for RF_rxringdrain().
+        Returns False if simpliciti.ihx hasn't been built."""
+        if not self.hasshellcode("simpliciti.ihx"):
+            return False;
+        self.CChaltcpu();
+        self.CCpokedatablock(0xFE00,addr+linktoken+jointoken);
+        self.shellcodefile("simpliciti.ihx",wait=0,alwaysreload=1);
+        return True;
+    def RF_rxringdrain(self):
+        """Drain the receive ring, returning (drops, packets) where each
+        packet is (timestamp, [len, payload..., rssi, lqi]) and the
+        timestamp counts the 32kHz sleep timer."""
+        self.CChaltcpu();
+        hdr=self.CCpeekdatablock(self.RXRING,6);
+        if hdr[0]!=self.RXRINGMAGIC:
+            self.CCreleasecpu();
+            return (0,[]);
+        head,tail,slots,slotlen=hdr[1:5];
+        drops=self.CCpeekdatablock(self.RXRING+6,2);
+        drops=drops[0]+(drops[1]<<8);
+        
+        #Read the filled slots, in as few blocks as fit the FET.
+        data=[];
+        i=tail;
+        while i!=head:
+            n=min((head-i)%slots,slots-i,self.CCBLOCKSIZE/slotlen);
+            data+=self.CCpeekdatablock(self.RXRINGSLOTS+i*slotlen,n*slotlen);
+            i=(i+n)%slots;
+        self.CCpokedatabyte(self.RXRING+2,head);
+        self.CCreleasecpu();
+        
+        packets=[];
+        for i in range(0,len(data),slotlen):
+            slot=data[i:i+slotlen];
+            ts=slot[0]+(slot[1]<<8)+(slot[2]<<16);
+            packets.append((ts,slot[4:min(slot[4]+7,slotlen)]));
+        return (drops,packets);
     def RF_txpacket(self,packet):
         """Transmit a packet.  Untested."""
         
@@ -666,6 +724,23 @@ class GoodFETCC(GoodFET):
         
         return 0;
     
+    def RF_rssisample(self,count,interval=1000):
+        """Sample RSSI count times, interval microseconds apart start
+        to start, in receive mode.  Returns the readings with the same
+        offset as RF_getrssi()."""
+        rssireg=self.symbols.get("RSSI");
+        samples=[];
+        self.CC_RFST_RX();
+        while len(samples)<count:
+            n=min(count-len(samples),0x200);
+            self.writecmd(self.APP,0xA1,6,
+                          [rssireg&0xFF,(rssireg>>8)&0xFF,
+                           interval&0xFF,(interval>>8)&0xFF,
+                           n&0xFF,(n>>8)&0xFF]);
+            samples+=[ord(x)^0x80 for x in self.data];
+        self.CC_RFST_IDLE();
+        return samples;
+    
     def SRF_loadsymbols(self):
         ident=self.CCident();
         chip=self.CCversions.get(ident&0xFF00);
@@ -768,6 +843,7 @@ class GoodFETCC(GoodFET):
                 0xB500:"cc2531",
                 0x9500:"cc2533",
                 0x8D00:"cc2540",
+                0x4100:"cc2541",
                 0xFF00:"CCmissing"};
     execbuf=None;
     CCexecbuf= {0x0100:0xF000,
@@ -791,6 +867,7 @@ class GoodFETCC(GoodFET):
                  0xB5: 2048, #"CC2531",
                  0x95: 2048, #"CC2533",
                  0x8D: 2048, #"CC2540",
+                 0x41: 2048, #"CC2541",
                  0xFF: None}
     def infostring(self):
         return self.CCidentstr();
@@ -830,6 +907,37 @@ class GoodFETCC(GoodFET):
         hi=ord(self.data[0]);
         lo=ord(self.data[1]);
         return (hi<<8)+lo;
+    def CCclockdelay(self,delay=None):
+        """Get or set the extra delay in each debug clock half period."""
+        if delay is None:
+            self.writecmd(self.APP,0x9F,0,None);
+        else:
+            self.writecmd(self.APP,0x9F,2,[delay&0xFF,(delay>>8)&0xFF]);
+        return ord(self.data[0])+(ord(self.data[1])<<8);
+    def CCautotune(self,iterations=8,slowest=0x100):
+        """Find the fastest reliable debug clock, returning its delay
+        or 0xFFFF if even the slowest failed."""
+        self.writecmd(self.APP,0xA0,4,
+                      [iterations,0,slowest&0xFF,(slowest>>8)&0xFF]);
+        return ord(self.data[0])+(ord(self.data[1])<<8);
+    def CCtrace(self,count,lo=0,hi=0,regs=0):
+        """Single-step the target count times, yielding (pc,) or
+        (pc,a,sp) after each step.  Stops early once the PC leaves
+        [lo,hi), unless hi is zero."""
+        data=[count&0xFF,(count>>8)&0xFF,(count>>16)&0xFF,(count>>24)&0xFF,
+              lo&0xFF,(lo>>8)&0xFF,hi&0xFF,(hi>>8)&0xFF,
+              regs&1,0];
+        self.writecmd(self.APP,0x9E,len(data),data);
+        size=2;
+        if regs: size=4;
+        while self.verb==0x9E:
+            for i in range(0,len(self.data),size):
+                rec=[ord(x) for x in self.data[i:i+size]];
+                if regs:
+                    yield (rec[0]+(rec[1]<<8),rec[2],rec[3]);
+                else:
+                    yield (rec[0]+(rec[1]<<8),);
+            self.readcmd();
     def CCcmd(self,phrase):
         self.writecmd(self.APP,0x00,len(phrase),phrase);
         val=ord(self.data[0]);
@@ -858,11 +966,26 @@ class GoodFETCC(GoodFET):
         self.data=[adr&0xff, (adr&0xff00)>>8];
         self.writecmd(self.APP,0x90,2,self.data);
         return ord(self.data[0]);
+    def CCpeekcodeblock(self,adr,length):
+        """Read a block of code memory, streamed by the GoodFET."""
+        data=[adr&0xff, (adr>>8)&0xff, (adr>>16)&0xff, (adr>>24)&0xff,
+              length&0xff, (length>>8)&0xff];
+        self.writecmd(self.APP,0x9B,6,data);
+        return [ord(x) for x in self.data];
     def CCpeekdatabyte(self,adr):
         """Read the contents of data memory at an address."""
         self.data=[adr&0xff, (adr&0xff00)>>8];
         self.writecmd(self.APP,0x91, 2, self.data);
         return ord(self.data[0]);
+    def CCpeekdatablock(self,adr,length):
+        """Read a block of data memory, CCBLOCKSIZE bytes per command."""
+        data=[];
+        for i in range(0,length,self.CCBLOCKSIZE):
+            n=min(length-i,self.CCBLOCKSIZE);
+            self.writecmd(self.APP,0x91,4,
+                          [(adr+i)&0xff, ((adr+i)>>8)&0xff, n&0xff, (n>>8)&0xff]);
+            data+=[ord(x) for x in self.data];
+        return data;
     def CCpeekirambyte(self,adr):
         """Read the contents of IRAM at an address."""
         self.data=[adr&0xff];
@@ -887,6 +1010,16 @@ class GoodFETCC(GoodFET):
         self.data=[adr&0xff, (adr&0xff00)>>8, val];
         self.writecmd(self.APP, 0x92, 3, self.data);
         return ord(self.data[0]);
+    #Bytes per block write, fitting the smallest cmddata buffer.
+    CCBLOCKSIZE=0x100;
+    def CCpokedatablock(self,adr,data):
+        """Write a list of bytes to data memory, a block per command."""
+        for i in range(0,len(data),self.CCBLOCKSIZE):
+            block=data[i:i+self.CCBLOCKSIZE];
+            self.writecmd(self.APP, 0x9C, len(block)+2,
+                          [(adr+i)&0xff, ((adr+i)>>8)&0xff]+block);
+            if self.verb!=0x9C:
+                raise Exception("Block write failed at %04x." % (adr+i));
     def CCchiperase(self):
         """Erase all of the target's memory."""
         self.writecmd(self.APP,0x80,0,None);
@@ -957,6 +1090,31 @@ class GoodFETCC(GoodFET):
         print "Flashing buffer to 0x%06x" % adr;
         self.writecmd(self.APP,0x95,4,data);
     
+    #Parts with BURST_WRITE, flashed by DMA rather than a routine in XDATA.
+    CCdmaparts=[0xA5, 0xB5, 0x95, 0x8D, 0x41];
+    #Bytes of page data per DMA write, what fits after the 8-byte header
+    #in the smallest cmddata buffer.
+    CCDMABLOCK=0xF8;
+    #XDATA scratch for the DMA descriptors and data, in CC253x SRAM.
+    CCDMABUF=0x0000;
+    def CCflashdma(self,adr,data,erase=0):
+        """Write a block of flash by BURST_WRITE and DMA, returning
+        the flash controller's status from the previous write."""
+        cmd=[adr&0xFF, (adr>>8)&0xFF, (adr>>16)&0xFF, (adr>>24)&0xFF,
+             self.CCDMABUF&0xFF, (self.CCDMABUF>>8)&0xFF,
+             erase&1, 0];
+        self.writecmd(self.APP,0x9D,len(cmd)+len(data),cmd+data);
+        if self.verb!=0x9D:
+            raise Exception("DMA flash write failed at %06x." % adr);
+        return ord(self.data[0]);
+    def CCflashpagedma(self,adr,page):
+        """Erase and write a page of flash by BURST_WRITE and DMA."""
+        fctl=0;
+        for i in range(0,len(page),self.CCDMABLOCK):
+            fctl|=self.CCflashdma(adr+i,page[i:i+self.CCDMABLOCK],i==0);
+        #Wait out the last block.
+        return fctl|self.CCflashdma(adr,[]);
+    
     def setsecret(self,value):
         """Set a secret word for later retreival.  Used by glitcher."""
         page = 0x0000;
@@ -1112,43 +1270,106 @@ class GoodFETCC(GoodFET):
         h = IntelHex(None);
         i=start;
         while i<=stop:
-            h[i]=self.CCpeekcodebyte(i);
-            if(i%0x100==0):
-                print "Dumped %04x."%i;
-                h.write_hex_file(file); #buffer to disk.
-            i+=1;
+            block=self.CCpeekcodeblock(i,min(0x800,stop+1-i));
+            for b in block:
+                h[i]=b;
+                i+=1;
+            print "Dumped %04x."%(i-1);
         h.write_hex_file(file);
 
-    def flash(self,file):
-        """Flash an intel hex file to code memory."""
+    def pages(self,h,pagelen):
+        """Group an IntelHex image into pages, padding with 0xFF."""
+        pages={};
+        for i in h._buf.keys():
+            page=i-(i%pagelen);
+            if not pages.has_key(page):
+                pages[page]=[0xFF]*pagelen;
+            pages[page][i-page]=h[i];
+        return pages;
+    def crc16(self,data):
+        """CRC16 as the RNG unit computes it, x^16+x^15+x^2+1 seeded
+        with 0xFFFF and fed MSB first."""
+        crc=0xFFFF;
+        for b in data:
+            crc^=b<<8;
+            for i in range(8):
+                if crc&0x8000:
+                    crc=((crc<<1)^0x8005)&0xFFFF;
+                else:
+                    crc=(crc<<1)&0xFFFF;
+        return crc;
+    #Pages per run of the CRC shellcode, as its table fits in 0xFE04-0xFEFF.
+    CCCRCPAGES=126;
+    crcshellcode=None;
+    def CCpagecrcs(self,first,count,pagelen):
+        """CRC16 a run of pages on the target, with crcpages.ihx."""
+        self.CCpokedatablock(0xFE00,[first,count,pagelen>>8,0]);
+        #Reload, as flashing overwrites the code at 0xF000.
+        self.shellcodefile("crcpages.ihx",alwaysreload=1);
+        self.writecmd(self.APP,0x91,4,[0x04,0xFE,(count*2)&0xFF,(count*2)>>8]);
+        return [ord(self.data[2*i])+(ord(self.data[2*i+1])<<8)
+                for i in range(count)];
+    def pagecrcs(self,adrs,pagelen):
+        """CRC16 each page of flash, mapping page address to CRC.
+
+        Pages of the unbanked lower 32kB are summed on the target,
+        others by reading them back.  The first call checks the
+        shellcode against a host read of page zero, and falls back to
+        reading everything if they disagree."""
+        crcs={};
+        if self.crcshellcode is None:
+            self.crcshellcode=(self.execbuf==0xF000 and
+                               self.CCpagecrcs(0,1,pagelen)[0]==
+                               self.crc16(self.CCpeekcodeblock(0,pagelen)));
+        local=[a for a in adrs if a+pagelen<=0x8000 and self.crcshellcode];
+        for i in range(0,len(local),self.CCCRCPAGES):
+            run=local[i:i+self.CCCRCPAGES];
+            #One run covers the span from the lowest page to the highest.
+            first=run[0]/pagelen;
+            count=min(run[-1]/pagelen-first+1,self.CCCRCPAGES);
+            sums=self.CCpagecrcs(first,count,pagelen);
+            for a in run:
+                if a/pagelen-first<count:
+                    crcs[a]=sums[a/pagelen-first];
+        for a in adrs:
+            if not crcs.has_key(a):
+                crcs[a]=self.crc16(self.CCpeekcodeblock(a,pagelen));
+        return crcs;
+    def verifypages(self,file):
+        """List the pages whose CRC differs from an intel hex file."""
+        h = IntelHex(file);
+        pagelen = self.CCpagesize();
+        pages=self.pages(h,pagelen);
+        adrs=pages.keys();
+        adrs.sort();
+        crcs=self.pagecrcs(adrs,pagelen);
+        return [a for a in adrs if crcs[a]!=self.crc16(pages[a])];
+    
+    def flash(self,file,incremental=0):
+        """Flash an intel hex file to code memory, skipping pages
+        whose CRC already matches when incremental."""
         print "Flashing %s" % file;
         
         h = IntelHex(file);
-        page = 0x0000;
         pagelen = self.CCpagesize(); #Varies by chip.
-        
-        #print "page=%04x, pagelen=%04x" % (page,pagelen);
-        
-        bcount = 0;
-        
-        #Wipe the RAM buffer for the next flash page.
-        self.CCeraseflashbuffer();
-        for i in h._buf.keys():
-            while(i>=page+pagelen):
-                if bcount>0:
-                    self.CCflashpage(page);
-                    #client.CCeraseflashbuffer();
-                    bcount=0;
-                    print "Flashed page at %06x" % page
-                page+=pagelen;
-                    
-            #Place byte into buffer.
-            self.CCpokedatabyte(0xF000+i-page,
-                                h[i]);
-            bcount+=1;
-            if(i%0x100==0):
-                print "Buffering %04x toward %06x" % (i,page);
-        #last page
-        self.CCflashpage(page);
-        print "Flashed final page at %06x" % page;
+        dma = (self.CCident()>>8) in self.CCdmaparts;
+        pages=self.pages(h,pagelen);
+        
+        adrs=pages.keys();
+        adrs.sort();
+        if incremental:
+            crcs=self.pagecrcs(adrs,pagelen);
+            adrs=[a for a in adrs if crcs[a]!=self.crc16(pages[a])];
+            print "%i pages differ." % len(adrs);
+        for page in adrs:
+            if dma:
+                #Stream the page straight into the flash controller.
+                if self.CCflashpagedma(page,pages[page])&0x20:
+                    print "Flash write aborted at %06x." % page;
+                print "Flashed page at %06x" % page;
+                continue;
+            #Fill the buffer in XDATA a block at a time, then flash it.
+            self.CCpokedatablock(0xF000,pages[page]);
+            self.CCflashpage(page);
+            print "Flashed page at %06x" % page;
 
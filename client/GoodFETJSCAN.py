@@ -0,0 +1,63 @@
+#!/usr/bin/env python
+# GoodFET JTAG pinout scanner client
+
+import sys, struct
+
+# Standard verbs
+NOK   = 0x7E
+OK    = 0x7F
+EXIST = 0x7C
+NMEM  = 0x7D
+
+# JSCAN commands
+JSCAN_CMD_SCAN      = 0x80
+JSCAN_CMD_ADDPIN    = 0x83
+JSCAN_CMD_RMPIN     = 0x84
+JSCAN_CMD_DELAY     = 0x85
+JSCAN_CMD_PULLUP    = 0x86
+JSCAN_CMD_LOOPBACK  = 0x87
+JSCAN_CMD_LISTPIN   = 0x88
+JSCAN_CMD_RESULTS   = 0x89
+JSCAN_CMD_PROGRESS  = 0x8a
+JSCAN_CMD_HIT       = 0x8b
+JSCAN_CMD_DONE      = 0x8c
+
+NOPIN = 0xff
+
+from GoodFET import GoodFET
+
+class GoodFETJSCAN(GoodFET):
+
+    """A GoodFET variant for finding JTAG pinouts."""
+
+    JSCANAPP=0x64;
+    APP=JSCANAPP;
+
+    def addpin(self, id, bit, ddr, pin, port):
+        """Add a pin by its AVR I/O register addresses."""
+        self.writecmd(self.APP, JSCAN_CMD_ADDPIN, 5, [id, bit, ddr, pin, port])
+        return self.verb == OK
+
+    def setdelay(self, us):
+        """Half TCK period, in microseconds."""
+        self.writecmd(self.APP, JSCAN_CMD_DELAY, 1, [us])
+
+    def scan(self, progress=None):
+        """Scan, yielding (tck, tms, tdi, tdo, nrst, idcode) for each hit as it streams in.
+        tdi and nrst are None when not found or not needed."""
+        self.writecmd(self.APP, JSCAN_CMD_SCAN)
+        if self.verb != OK:
+            raise Exception("Scan needs at least four pins, and at most eight ports")
+        while True:
+            self.readcmd()
+            if self.verb == JSCAN_CMD_DONE:
+                return
+            elif self.verb == JSCAN_CMD_PROGRESS:
+                if progress:
+                    nrst, done, total = [ord(x) for x in self.data[:3]]
+                    progress(nrst, done, total)
+            elif self.verb == JSCAN_CMD_HIT:
+                pins = [ord(x) for x in self.data[:5]]
+                pins = [(None if x == NOPIN else x) for x in pins]
+                idcode = struct.unpack("<L", self.data[5:9])[0]
+                yield tuple(pins) + (idcode,)
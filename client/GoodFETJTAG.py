@@ -1,7 +1,7 @@
 #!/usr/bin/env python
 # GoodFET Basic JTAG Client
 
-import sys, binascii, struct
+import sys, os, binascii, struct
 
 # Standard verbs
 READ  = 0x00
@@ -22,6 +22,16 @@ JTAG_RESET_TARGET           = 0x83
 JTAG_DETECT_IR_WIDTH        = 0x84
 JTAG_DETECT_CHAIN_LENGTH    = 0x85
 JTAG_GET_DEVICE_ID          = 0x86
+JTAG_CHAIN_SCAN             = 0x8A
+JTAG_CHAIN_SELECT           = 0x8B
+JTAG_CHAIN_SET_IRLEN        = 0x8C
+JTAG_SET_TCK_DELAY          = 0xA9
+JTAG_AUTOTUNE               = 0xAA
+JTAG_BSCAN_CAPTURE          = 0xAB
+
+# Per-target TCK delays, one "IDCODE delay" line each.  "last" is used
+# when the chain can't be read at full speed to find the IDCODE.
+TCK_PROFILE = os.environ.get("GOODFETTCK", os.path.expanduser("~/.goodfet-tck"))
 
 from GoodFET import GoodFET
 from intelhex import IntelHex
@@ -79,4 +89,111 @@ class GoodFETJTAG(GoodFET):
         id = struct.unpack("!L", self.data)[0]
         return id
 
+    def _chain(self):
+        """Unpack a chain model reply into (target, [(irlen, idcode), ...])."""
+        count, target = ord(self.data[0]), ord(self.data[1])
+        taps = []
+        for i in range(count):
+            irlen, idcode = struct.unpack("!BL", self.data[2+5*i:7+5*i])
+            taps.append((irlen, idcode))
+        return target, taps
+
+    def chain_scan(self):
+        """Rescan the chain.  TAP 0 is nearest TDO."""
+        self.writecmd(self.APP, JTAG_CHAIN_SCAN)
+        return self._chain()
+
+    def chain_select(self, tap):
+        """Aim later IR/DR shifts at one TAP, with the others in BYPASS."""
+        self.writecmd(self.APP, JTAG_CHAIN_SELECT, 1, [tap])
+        if self.verb != JTAG_CHAIN_SELECT:
+            raise Exception("No TAP %d in the chain" % tap)
+        return self._chain()
+
+    def chain_set_irlen(self, irlens):
+        """Override the IR lengths, for chains whose capture patterns can't be split."""
+        self.writecmd(self.APP, JTAG_CHAIN_SET_IRLEN, len(irlens), list(irlens))
+        return self._chain()
+
+    def set_tck_delay(self, delay):
+        """Set the extra delay() count per TCK half period, 0 being full speed."""
+        self.writecmd(self.APP, JTAG_SET_TCK_DELAY, 2, struct.pack("!H", delay))
+        return struct.unpack("!H", self.data[:2])[0]
+
+    def autotune(self, iterations=8, slowest=0x400):
+        """Find the shortest TCK delay giving stable IDCODE and BYPASS reads.
+        Returns (delay, idcode), with delay None if no speed was stable."""
+        self.writecmd(self.APP, JTAG_AUTOTUNE, 3,
+                      [iterations, slowest>>8, slowest&0xff])
+        delay, idcode, offset = struct.unpack("!HLB", self.data[:7])
+        if delay == 0xffff:
+            return None, idcode
+        return delay, idcode
+
+    def load_tck_profile(self):
+        profile = {}
+        try:
+            for line in open(TCK_PROFILE):
+                words = line.split()
+                if len(words) == 2:
+                    profile[words[0]] = int(words[1])
+        except IOError:
+            pass
+        return profile
+
+    def save_tck_profile(self, idcode, delay, margin=0.25):
+        """Store a tuned delay for this IDCODE, with some margin added."""
+        profile = self.load_tck_profile()
+        delay = delay + int(delay*margin + 0.5)
+        profile["%08x" % idcode] = delay
+        profile["last"] = delay
+        f = open(TCK_PROFILE, "w")
+        for key in sorted(profile):
+            f.write("%s %d\n" % (key, profile[key]))
+        f.close()
+        return delay
+
+    def idcode(self):
+        """Read TAP 0's IDCODE quietly; the key for the TCK profile."""
+        self.writecmd(self.APP, JTAG_GET_DEVICE_ID, 2, struct.pack("!H", 0))
+        if self.verb != JTAG_GET_DEVICE_ID or len(self.data) != 4:
+            return None
+        id = struct.unpack("!L", self.data)[0]
+        if not id & 1 or id == 0xffffffff:
+            return None
+        return id
+
+    def apply_tck_profile(self):
+        """Start at the stored delay for the first TAP, if there is one.
+        The chain model is left alone; scan it explicitly if needed."""
+        profile = self.load_tck_profile()
+        id = self.idcode()
+        if id is not None and "%08x" % id in profile:
+            return self.set_tck_delay(profile["%08x" % id])
+        if "last" in profile and id is None:
+            self.set_tck_delay(profile["last"])
+            id = self.idcode()
+            if id is not None and "%08x" % id in profile:
+                return self.set_tck_delay(profile["%08x" % id])
+            return profile["last"]
+        return None
 
+    def bscan_capture(self, irlen, instr, bits, count):
+        """Load instr, normally SAMPLE/PRELOAD, then capture the boundary
+        register count times, yielding each sample as a list of bytes
+        with cell 0 in the LSB of the first."""
+        self.writecmd(self.APP, JTAG_BSCAN_CAPTURE, 9,
+                      struct.pack("!BLHH", irlen, instr, bits, count))
+        if self.verb == NOK:
+            raise Exception("Boundary register too long, or bad IR length")
+        sample = [0] * ((bits + 7) / 8)
+        while self.verb == JTAG_BSCAN_CAPTURE:
+            data = [ord(x) for x in self.data]
+            i = 0
+            while i < len(data):
+                n = data[i]
+                for j in range(n):
+                    sample[data[i+1+2*j]] ^= data[i+2+2*j]
+                i += 1 + 2*n
+                yield list(sample)
+            self.readcmd()
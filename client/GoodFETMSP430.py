@@ -174,6 +174,8 @@ class GoodFETMSP430(GoodFET):
         0xf46f: "MSP430FG46xx", #or F471xx
         0xF413: "MSP430F413", #or maybe others.
         }
+    #Identities of the MSP430X parts with the older 0x89 JTAG ID.
+    MSP430Xdevices=(0xf26f, 0xf46f);
     def MSP430test(self):
         """Test MSP430 JTAG.  Requires that a chip be attached."""
         
@@ -232,6 +234,24 @@ class GoodFETMSP430(GoodFET):
         self.writecmd(self.MSP430APP,0xD3,1,[reg]);
         return ord(self.data[0])+(ord(self.data[1])<<8);
 
+    def MSP430profile(self,base,shift,buckets,samples,ms=0):
+        """Sample the PC of the running target.  Returns (outside,
+        asleep, counts), where counts[i] is the number of samples in
+        [base+(i<<shift), base+((i+1)<<shift)).  The FET may return
+        fewer buckets than asked for."""
+        data=[base&0xFF,(base>>8)&0xFF,(base>>16)&0xFF,(base>>24)&0xFF,
+              shift,0,
+              buckets&0xFF,(buckets>>8)&0xFF,
+              samples&0xFF,(samples>>8)&0xFF,
+              ms&0xFF,(ms>>8)&0xFF];
+        self.writecmd(self.MSP430APP,0xD4,len(data),data);
+        counts=struct.unpack("<%iH" % (len(self.data)/2), self.data);
+        return (counts[0],counts[1],counts[2:]);
+    def MSP430profilebuckets(self):
+        """Largest bucket count the FET will fill, found by asking for
+        every bucket with no samples, which leaves the CPU halted."""
+        outside,asleep,counts=self.MSP430profile(0,1,0xFFFF,0);
+        return len(counts);
     def MSP430run(self):
         """Reset the MSP430 to run on its own."""
         self.writecmd(self.MSP430APP,0x21,0,None);
@@ -244,3 +264,156 @@ class GoodFETMSP430(GoodFET):
         while i<end:
             print "%04x %04x" % (i, self.MSP430peek(i));
             i+=2;
+    
+    #Block access, which needs the JTAG430X2 app.
+    MSP430VACANT=0x3FFF;     #Vacant memory reads as JMP $.
+    MSP430MAILBOXDONE=0xA55A;
+    #Words per block write, fitting the smallest cmddata buffer.
+    MSP430BLOCKWORDS=0x80;
+    def MSP430readregions(self,regions):
+        """Read a list of (start,end) regions in one burst, returning
+        a string for each.  End addresses are exclusive."""
+        data=[];
+        for start,end in regions:
+            data+=[start&0xFF,(start>>8)&0xFF,(start>>16)&0xFF,(start>>24)&0xFF,
+                   end&0xFF,(end>>8)&0xFF,(end>>16)&0xFF,(end>>24)&0xFF];
+        self.writecmd(self.MSP430APP,0xE9,len(data),data);
+        buf="";
+        while self.verb==0xE9:
+            buf+=self.data;
+            self.readcmd();
+        if self.verb!=0x7F:
+            raise Exception("Block read failed.");
+        out=[];
+        for start,end in regions:
+            l=((end-start)+1)&~1;
+            out.append(buf[:l]);
+            buf=buf[l:];
+        return out;
+    def MSP430readblock(self,start,end):
+        """Read [start,end) as a string, using burst reads."""
+        return self.MSP430readregions([(start,end)])[0];
+    def MSP430writeblock(self,adr,words):
+        """Write a list of words to RAM, a block per command."""
+        while words:
+            chunk=words[:self.MSP430BLOCKWORDS];
+            words=words[self.MSP430BLOCKWORDS:];
+            data=[adr&0xFF,(adr>>8)&0xFF,(adr>>16)&0xFF,(adr>>24)&0xFF];
+            for w in chunk:
+                data+=[w&0xFF,(w>>8)&0xFF];
+            self.writecmd(self.MSP430APP,0xEA,len(data),data);
+            if self.verb!=0xEA:
+                raise Exception("Block write failed at %06x." % adr);
+            adr+=2*len(chunk);
+    def MSP430funclet(self,entry,mailbox,ms):
+        """Run a funclet from entry for ms milliseconds, then return
+        the word it left in its mailbox."""
+        data=[entry&0xFF,(entry>>8)&0xFF,(entry>>16)&0xFF,(entry>>24)&0xFF,
+              mailbox&0xFF,(mailbox>>8)&0xFF,(mailbox>>16)&0xFF,(mailbox>>24)&0xFF,
+              ms&0xFF,(ms>>8)&0xFF];
+        self.writecmd(self.MSP430APP,0xEB,len(data),data);
+        return ord(self.data[0])+(ord(self.data[1])<<8);
+    
+    def MSP430memorymap(self,page=0x400,top=None):
+        """Find the mapped pages of the address space by sampling the
+        start of each page.  Pages that read back as vacant memory are
+        skipped, and the rest are merged into a list of (start,end)
+        regions.  The sweep stops at 64kB unless the part is an
+        MSP430X, and never reads the peripherals, whose registers can
+        change when read."""
+        if top is None:
+            top=self.MSP430isX() and 0x100000 or 0x10000;
+        base=self.MSP430peripheralend();
+        pages=[base]+range((base+page)&~(page-1),top,page);
+        mapped=[];
+        for i in range(0,len(pages),0x20):
+            batch=[(p,p+0x10) for p in pages[i:i+0x20]];
+            for (p,end),data in zip(batch,self.MSP430readregions(batch)):
+                words=struct.unpack("<8H",data);
+                if words!=(self.MSP430VACANT,)*8:
+                    mapped.append(p);
+        regions=[];
+        for p in mapped:
+            if regions and regions[-1][1]==p:
+                regions[-1]=(regions[-1][0],(p&~(page-1))+page);
+            else:
+                regions.append((p,(p&~(page-1))+page));
+        return regions;
+    def MSP430isX(self):
+        """True for MSP430X and MSP430X2 parts, which map past 64kB."""
+        return self.JTAGID==0x91 or self.MSP430ident() in self.MSP430Xdevices;
+    def MSP430peripheralend(self):
+        """First address past the peripheral registers."""
+        if self.JTAGID==0x91:
+            return 0x1000;
+        return 0x0200;
+    def MSP430dumpregions(self,regions,progress=None):
+        """Dump regions into a dictionary of {start: string}."""
+        dump={};
+        for start,end in regions:
+            for adr in range(start,end,0x4000):
+                dump[adr]=self.MSP430readblock(adr,min(adr+0x4000,end));
+                if progress: progress(adr,end);
+        return dump;
+    
+    def MSP430flashregs(self):
+        """Watchdog and flash controller registers as (WDTCTL, FCTL1,
+        FCTL2, FCTL3, RAM).  FCTL2 is None on the F5xx, whose flash
+        timing generator is internal."""
+        if self.JTAGID==0x91:
+            return (0x015C,0x0140,None,0x0144,0x1C00);
+        if self.MSP430ident() in (0xf26f,0xf46f):
+            return (0x0120,0x0128,0x012A,0x012C,0x1100);
+        return (0x0120,0x0128,0x012A,0x012C,0x0200);
+    def MSP430flashfunclet(self,dest,buf,count,mailbox):
+        """Assemble a funclet that writes count words from buf in RAM
+        to erased flash at dest, then marks its mailbox done.  20-bit
+        destinations use MOVA/ADDA, so they need an MSP430X CPU."""
+        wdt,fctl1,fctl2,fctl3,ram=self.MSP430flashregs();
+        def jnz(at,target):
+            return 0x2000|((target-at-1)&0x3FF);
+        code=[0x40B2,0x5A80,wdt];                 #MOV #WDTPW|WDTHOLD, &WDTCTL
+        if fctl2 is not None:
+            code+=[0x40B2,0xA542,fctl2];          #MOV #FWKEY|FSSEL_1|2, &FCTL2 (MCLK/3)
+        code+=[0x40B2,0xA500,fctl3];              #MOV #FWKEY, &FCTL3 (unlock)
+        code+=[0x40B2,0xA540,fctl1];              #MOV #FWKEY|WRT, &FCTL1
+        if dest+2*count>0x10000:
+            code+=[0x008C|((dest>>8)&0x0F00),dest&0xFFFF]; #MOVA #dest, R12
+            inc=[0x00AC,0x0002];                  #ADDA #2, R12
+        else:
+            code+=[0x403C,dest];                  #MOV #dest, R12
+            inc=[0x532C];                         #INCD R12
+        code+=[0x403D,buf,0x403E,count];          #MOV #buf, R13; MOV #count, R14
+        loop=len(code);
+        code+=[0x4DBC,0x0000];                    #MOV @R13+, 0(R12)
+        busy=len(code);
+        code+=[0xB392,fctl3];                     #BIT #BUSY, &FCTL3
+        code+=[jnz(len(code),busy)];              #JNZ busy
+        code+=inc;
+        code+=[0x831E];                           #DEC R14
+        code+=[jnz(len(code),loop)];              #JNZ loop
+        code+=[0x40B2,0xA500,fctl1];              #MOV #FWKEY, &FCTL1
+        code+=[0x40B2,0xA510,fctl3];              #MOV #FWKEY|LOCK, &FCTL3
+        code+=[0x40B2,self.MSP430MAILBOXDONE,mailbox]; #MOV #done, &mailbox
+        code+=[0x3FFF];                           #JMP $
+        return code;
+    def MSP430flashblock(self,adr,words):
+        """Write words to erased flash at adr through a RAM funclet,
+        a RAM buffer at a time."""
+        wdt,fctl1,fctl2,fctl3,ram=self.MSP430flashregs();
+        mailbox=ram;
+        entry=ram+2;
+        buf=ram+0x60;
+        size=0x100;
+        if ram==0x0200: size=0x40;  #Small parts have little RAM.
+        while words:
+            chunk=words[:size];
+            words=words[size:];
+            code=self.MSP430flashfunclet(adr,buf,len(chunk),mailbox);
+            self.MSP430writeblock(mailbox,[0]+code);
+            self.MSP430writeblock(buf,chunk);
+            #About 100us per word, with room to spare.
+            done=self.MSP430funclet(entry,mailbox,5+len(chunk)/6);
+            if done!=self.MSP430MAILBOXDONE:
+                raise Exception("Flash funclet failed at %06x, mailbox %04x." % (adr,done));
+            adr+=2*len(chunk);
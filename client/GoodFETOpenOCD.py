@@ -0,0 +1,171 @@
+#!/usr/bin/env python
+# GoodFET OpenOCD bitbang client, with a remote_bitbang bridge
+
+import sys, struct, socket
+
+# Standard verbs
+SETUP = 0x10
+START = 0x20
+STOP  = 0x21
+NOK   = 0x7E
+OK    = 0x7F
+
+# OpenOCD commands
+OPENOCD_RESET   = 0x80
+OPENOCD_READ    = 0x81
+OPENOCD_WRITE   = 0x82
+OPENOCD_LED     = 0x83
+OPENOCD_SCAN    = 0x84
+JTAG_SET_TCK_DELAY = 0xA9
+
+# TMS/TDI pairs per OPENOCD_SCAN, four to a byte after the count
+SCAN_MAX_STEPS  = 0x400
+
+from GoodFET import GoodFET
+
+class GoodFETOpenOCD(GoodFET):
+
+    """A GoodFET variant for driving JTAG pins on behalf of OpenOCD."""
+
+    OPENOCDAPP=0x18;
+    APP=OPENOCDAPP;
+
+    def setup(self):
+        """Move the FET into the OpenOCD configuration."""
+        self.writecmd(self.APP, SETUP)
+
+    def reset(self, trst, srst):
+        self.writecmd(self.APP, OPENOCD_RESET, 2, [trst&1, srst&1])
+
+    def led(self, on):
+        self.writecmd(self.APP, OPENOCD_LED, 1, [on&1])
+
+    def set_tck_delay(self, delay):
+        """Slow the batched scans down, 0 being full speed."""
+        self.writecmd(self.APP, JTAG_SET_TCK_DELAY, 2, struct.pack("!H", delay))
+
+    def write(self, tck, tms, tdi):
+        self.writecmd(self.APP, OPENOCD_WRITE, 3, [tck&1, tms&1, tdi&1])
+
+    def read(self):
+        self.writecmd(self.APP, OPENOCD_READ)
+        return ord(self.data[0]) & 1
+
+    def scan(self, steps):
+        """Clock a list of (tms, tdi) pairs, returning the TDO sampled for each."""
+        tdo = []
+        while steps:
+            chunk = steps[:SCAN_MAX_STEPS]
+            steps = steps[SCAN_MAX_STEPS:]
+            data = [len(chunk)&0xff, len(chunk)>>8]
+            for i in xrange(0, len(chunk), 4):
+                byte = 0
+                for j, (tms, tdi) in enumerate(chunk[i:i+4]):
+                    byte |= ((tms&1)<<1 | (tdi&1)) << (2*j)
+                data.append(byte)
+            self.writecmd(self.APP, OPENOCD_SCAN, len(data), data)
+            for i in xrange(len(chunk)):
+                tdo.append((ord(self.data[i>>3]) >> (i&7)) & 1)
+        return tdo
+
+
+class RemoteBitbang:
+
+    """Speaks OpenOCD's remote_bitbang protocol, coalescing each
+    received buffer of pin writes into OPENOCD_SCAN batches.
+
+    A rising TCK edge becomes one (tms, tdi) step.  An 'R' with TCK low
+    reads the TDO of the step about to be clocked, which the GoodFET
+    samples just before raising TCK; with TCK high it reads the last
+    step's TDO, which holds until the next falling edge.  When OpenOCD
+    waits on a read whose step has not been clocked yet, the step is
+    clocked early and OpenOCD's own rising edge is then absorbed."""
+
+    def __init__(self, client):
+        self.client = client
+        self.tck = 1
+        self.tms = 0
+        self.tdi = 0
+        self.steps = []         # (tms, tdi) not yet sent
+        self.nsteps = 0         # steps ever taken, sent or not
+        self.reads = []         # step index each pending 'R' wants
+        self.risen = False      # current low phase was already clocked
+        self.last_tdo = None
+        self.quit = False
+
+    def flush(self):
+        """Clock the pending steps and answer the pending reads."""
+        if self.reads and self.reads[-1] == self.nsteps:
+            self.steps.append((self.tms, self.tdi))
+            self.nsteps += 1
+            self.risen = True
+        base = self.nsteps - len(self.steps)
+        tdo = self.client.scan(self.steps)
+        out = []
+        for idx in self.reads:
+            if idx >= base:
+                bit = tdo[idx-base]
+            elif self.last_tdo != None:
+                bit = self.last_tdo
+            else:
+                bit = self.client.read()
+            out.append("01"[bit])
+        if tdo:
+            self.last_tdo = tdo[-1]
+        self.steps = []
+        self.reads = []
+        return "".join(out)
+
+    def process(self, buf):
+        """Handle a buffer of remote_bitbang commands, returning the replies."""
+        out = []
+        for c in buf:
+            if '0' <= c <= '7':
+                v = ord(c) - ord('0')
+                tck, tms, tdi = (v>>2)&1, (v>>1)&1, v&1
+                if tck and not self.tck:
+                    if self.risen:
+                        self.risen = False
+                    else:
+                        self.steps.append((tms, tdi))
+                        self.nsteps += 1
+                        if len(self.steps) >= SCAN_MAX_STEPS and not self.reads:
+                            out.append(self.flush())
+                self.tck, self.tms, self.tdi = tck, tms, tdi
+            elif c == 'R':
+                if self.tck or self.risen:
+                    self.reads.append(self.nsteps - 1)
+                else:
+                    self.reads.append(self.nsteps)
+            elif c in 'rstu':
+                out.append(self.flush())
+                v = ord(c) - ord('r')
+                self.client.reset((v>>1)&1, v&1)
+            elif c in 'Bb':
+                out.append(self.flush())
+                self.client.led(c == 'B')
+            elif c == 'Q':
+                self.quit = True
+                break
+        out.append(self.flush())
+        return "".join(out)
+
+    def serve(self, port=3335, host="127.0.0.1"):
+        """Accept OpenOCD connections, one at a time, until one sends Q."""
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        sock.bind((host, port))
+        sock.listen(1)
+        while not self.quit:
+            print "Waiting for OpenOCD on %s:%d" % (host, port)
+            conn, addr = sock.accept()
+            conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            while not self.quit:
+                buf = conn.recv(4096)
+                if not buf:
+                    break
+                reply = self.process(buf)
+                if reply:
+                    conn.sendall(reply)
+            conn.close()
+        sock.close()
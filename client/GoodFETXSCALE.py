@@ -18,6 +18,31 @@ OK    = 0x7F
 
 # XSCALE JTAG verbs
 # verbs start at 0xF0
+XSCALE_DCSR         = 0xF0
+XSCALE_LOAD_IC      = 0xF1
+XSCALE_DBGRX        = 0xF2
+XSCALE_DBGTX        = 0xF3
+XSCALE_READ_BLOCK   = 0xF4
+XSCALE_WRITE_BLOCK  = 0xF5
+
+# SELDCSR control bits
+DCSR_HOLD_RST       = 0x02
+DCSR_EXT_DBG_BREAK  = 0x04
+
+# DCSR bits
+DCSR_GE             = 0x80000000
+DCSR_H              = 0x40000000
+DCSR_TR             = 0x00010000
+DCSR_SA             = 0x00000020
+
+# Words per block transfer
+READ_BLOCK_WORDS    = 0x400
+WRITE_BLOCK_WORDS   = 0x3f
+# Cache lines per LOAD_IC packet
+LOAD_IC_LINES       = 7
+
+# Where the debug handler lives in the mini ICache
+HANDLER_ADDRESS     = 0xfe000800
 
 from GoodFETJTAG import GoodFETJTAG
 from intelhex import IntelHex
@@ -35,10 +60,10 @@ class GoodFETXSCALE(GoodFETJTAG):
         self.writecmd(self.APP, SETUP)
         self._check_return(SETUP)
 
-    def start(self):
-        """Start debugging."""
+    def start(self, irlen=5):
+        """Start debugging.  irlen is 7 on cores with a CoreGen of 2."""
         sys.stdout.write("Staring session...")
-        self.writecmd(self.APP, START)
+        self.writecmd(self.APP, START, 1, [irlen])
         self._check_return(START)
 
     def stop(self):
@@ -47,4 +72,87 @@ class GoodFETXSCALE(GoodFETJTAG):
         self.writecmd(self.APP, STOP)
         self._check_return(STOP)
 
+    def dcsr(self, value=None, ctrl=0):
+        """Write the DCSR, or just read it if value is None.  Returns the
+        value captured before the write."""
+        if value is None:
+            self.writecmd(self.APP, XSCALE_DCSR)
+        else:
+            self.writecmd(self.APP, XSCALE_DCSR, 5, struct.pack("<BL", ctrl, value))
+        return struct.unpack("<L", self.data[:4])[0]
+
+    def load_ic(self, address, data, invalidate=False):
+        """Load whole 32-byte lines into the mini ICache, a few lines
+        to a packet."""
+        data = data + "\0" * (-len(data) % 32)
+        lines = 0
+        for i in range(0, len(data), 32*LOAD_IC_LINES):
+            chunk = data[i:i+32*LOAD_IC_LINES]
+            self.writecmd(self.APP, XSCALE_LOAD_IC, 5 + len(chunk),
+                          struct.pack("<LB", address + i, int(invalidate)) + chunk)
+            if self.verb != XSCALE_LOAD_IC:
+                raise Exception("LOAD_IC failed at 0x%08x" % (address + i))
+            lines += struct.unpack("<H", self.data[:2])[0]
+            invalidate = False
+        return lines
+
+    def send(self, word):
+        """Send a word to the debug handler through DBGRX."""
+        self.writecmd(self.APP, XSCALE_DBGRX, 4, struct.pack("<L", word))
+        if ord(self.data[0]):
+            raise Exception("Debug handler is not reading DBGRX")
+
+    def receive(self):
+        """Receive a word from the debug handler through DBGTX, or None."""
+        self.writecmd(self.APP, XSCALE_DBGTX)
+        word, err = struct.unpack("<LB", self.data[:5])
+        if err:
+            return None
+        return word
+
+    def install_handler(self, image, address=HANDLER_ADDRESS):
+        """Hold the core in reset, load a debug handler into the mini
+        ICache with vectors that trap into it, then let the core go."""
+        dcsr = DCSR_GE | DCSR_H | DCSR_TR
+        self.dcsr(dcsr, DCSR_HOLD_RST)
+        self.reset_target()
+        self.load_ic(address, image, True)
+        def branch(at, to):
+            return 0xea000000 | (((to - at - 8) >> 2) & 0xffffff)
+        for base in (0x00000000, 0xffff0000):
+            vectors = [branch(base, address + 0x20)]
+            vectors += [branch(base + 4*i, base + 4*i) for i in range(1, 8)]
+            self.load_ic(base, struct.pack("<8L", *vectors))
+        self.dcsr(dcsr, 0)
+        # the handler reports in with its saved state
+        state = []
+        while True:
+            word = self.receive()
+            if word is None:
+                return state
+            state.append(word)
+
+    def readBlock(self, adr, count):
+        """Read words through the debug handler, as a list."""
+        words = []
+        while count:
+            n = min(count, READ_BLOCK_WORDS)
+            self.writecmd(self.APP, XSCALE_READ_BLOCK, 6, struct.pack("<LH", adr, n))
+            data = struct.unpack("<%dL" % (n + 1), self.data[:4*(n+1)])
+            if data[-1] & DCSR_SA:
+                raise Exception("Abort reading 0x%08x" % adr)
+            words += data[:-1]
+            adr += 4*n
+            count -= n
+        return words
 
+    def writeBlock(self, adr, words):
+        """Write words through the debug handler."""
+        while words:
+            chunk = words[:WRITE_BLOCK_WORDS]
+            words = words[WRITE_BLOCK_WORDS:]
+            data = struct.pack("<L%dL" % len(chunk), adr, *chunk)
+            self.writecmd(self.APP, XSCALE_WRITE_BLOCK, len(data), data)
+            if struct.unpack("<L", self.data[:4])[0] & DCSR_SA:
+                raise Exception("Abort writing 0x%08x" % adr)
+            adr += 4*len(chunk)
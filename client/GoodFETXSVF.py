@@ -0,0 +1,195 @@
+#!/usr/bin/env python
+# GoodFET XSVF player client, with an SVF to XSVF converter
+
+import sys, struct, re
+
+# Standard verbs
+SETUP = 0x10
+START = 0x20
+STOP  = 0x21
+NOK   = 0x7E
+OK    = 0x7F
+
+# XSVF commands
+XSVF_DATA   = 0x90
+XSVF_STATUS = 0x91
+
+# Player status
+XSVF_RUNNING          = 0x00
+XSVF_COMPLETE         = 0x01
+XSVF_ERROR_MISMATCH   = 0x02
+XSVF_ERROR_ILLEGALCMD = 0x03
+XSVF_ERROR_TOOBIG     = 0x04
+
+STATUS_NAMES = {
+    XSVF_RUNNING:          "running",
+    XSVF_COMPLETE:         "complete",
+    XSVF_ERROR_MISMATCH:   "TDO mismatch",
+    XSVF_ERROR_ILLEGALCMD: "illegal instruction",
+    XSVF_ERROR_TOOBIG:     "vector too long for the firmware",
+}
+
+# XSVF instructions, from Xilinx XAPP503
+XCOMPLETE = 0x00
+XTDOMASK  = 0x01
+XSIR      = 0x02
+XSDR      = 0x03
+XRUNTEST  = 0x04
+XREPEAT   = 0x07
+XSDRSIZE  = 0x08
+XSDRTDO   = 0x09
+XSTATE    = 0x12
+XENDIR    = 0x13
+XENDDR    = 0x14
+XSIR2     = 0x15
+XWAIT     = 0x17
+
+# Bytes of XSVF per XSVF_DATA packet
+XSVF_CHUNK = 0x100
+
+# SVF stable and path states, in XSVF numbering
+SVF_STATES = {
+    "RESET": 0, "IDLE": 1,
+    "DRSELECT": 2, "DRCAPTURE": 3, "DRSHIFT": 4, "DREXIT1": 5,
+    "DRPAUSE": 6, "DREXIT2": 7, "DRUPDATE": 8,
+    "IRSELECT": 9, "IRCAPTURE": 10, "IRSHIFT": 11, "IREXIT1": 12,
+    "IRPAUSE": 13, "IREXIT2": 14, "IRUPDATE": 15,
+}
+
+from GoodFET import GoodFET
+
+class GoodFETXSVF(GoodFET):
+
+    """A GoodFET variant for playing XSVF files."""
+
+    XSVFAPP=0x1A;
+    APP=XSVFAPP;
+
+    def setup(self):
+        """Move the FET into the XSVF configuration and reset the player."""
+        self.writecmd(self.APP, SETUP)
+
+    def feed(self, data):
+        """Send a chunk of XSVF, returning the player status."""
+        self.writecmd(self.APP, XSVF_DATA, len(data), data)
+        return ord(self.data[0])
+
+    def status(self):
+        """Returns (status, last instruction, instructions run,
+        captured TDO, expected TDO, TDO mask) as hex strings."""
+        self.writecmd(self.APP, XSVF_STATUS)
+        status, cmd, n, count = struct.unpack("<BBHL", self.data[:8])
+        vecs = [self.data[8+i*n:8+(i+1)*n].encode("hex") for i in range(3)]
+        return (status, cmd, count) + tuple(vecs)
+
+    def play(self, xsvf, progress=None):
+        """Play a whole XSVF file, given as a string.  Returns the final status."""
+        self.setup()
+        status = XSVF_RUNNING
+        for i in xrange(0, len(xsvf), XSVF_CHUNK):
+            status = self.feed(xsvf[i:i+XSVF_CHUNK])
+            if progress:
+                progress(min(i+XSVF_CHUNK, len(xsvf)), len(xsvf))
+            if status != XSVF_RUNNING:
+                break
+        return status
+
+
+def svf2xsvf(svf):
+    """Convert the common subset of SVF to XSVF.
+
+    Handles SIR, SDR, RUNTEST, STATE, ENDIR and ENDDR, which is what
+    vendor tools emit for single-device chains.  FREQUENCY and TRST
+    are ignored, and HIR/HDR/TIR/TDR must be zero."""
+    svf = re.sub(r"(!|//)[^\n]*", "", svf)
+    out = [chr(XREPEAT), chr(0), chr(XRUNTEST), struct.pack(">L", 0)]
+    sdrsize = None
+    mask = None
+    tdi = {"SIR": {}, "SDR": {}}
+    endir = enddr = 1
+    runstate = 1
+
+    for stmt in svf.split(";"):
+        words = stmt.replace("(", " ( ").replace(")", " ) ").upper().split()
+        if not words:
+            continue
+        op = words[0]
+        if op in ("SIR", "SDR"):
+            bits = int(words[1])
+            args = {}
+            i = 2
+            while i < len(words):
+                key = words[i]
+                if words[i+1] != "(":
+                    raise Exception("Bad %s: %s" % (op, stmt.strip()))
+                j = words.index(")", i+2)
+                args[key] = "".join(words[i+2:j])
+                i = j+1
+            nbytes = (bits+7)/8
+            def vec(name, default):
+                # TDI and MASK carry over while the length stays the same
+                v = args.get(name)
+                if v is None:
+                    v = tdi[op].get((name, bits), default)
+                tdi[op][(name, bits)] = v
+                return v.rjust(nbytes*2, "0")[-nbytes*2:].decode("hex")
+            vtdi = vec("TDI", "0")
+            if op == "SIR":
+                if bits < 0x100:
+                    out.append(chr(XSIR) + chr(bits) + vtdi)
+                else:
+                    out.append(chr(XSIR2) + struct.pack(">H", bits) + vtdi)
+                continue
+            if bits != sdrsize:
+                out.append(chr(XSDRSIZE) + struct.pack(">L", bits))
+                sdrsize = bits
+            if "TDO" in args:
+                vtdo = args["TDO"].rjust(nbytes*2, "0")[-nbytes*2:].decode("hex")
+                vmask = vec("MASK", "F"*nbytes*2)
+            else:
+                vtdo = "\0"*nbytes
+                vmask = "\0"*nbytes
+            if vmask != mask:
+                out.append(chr(XTDOMASK) + vmask)
+                mask = vmask
+            out.append(chr(XSDRTDO) + vtdi + vtdo)
+        elif op == "RUNTEST":
+            args = words[1:]
+            state = runstate
+            if args and args[0] in SVF_STATES:
+                state = runstate = SVF_STATES[args.pop(0)]
+            us = 0
+            end = state
+            while args:
+                a = args.pop(0)
+                if a == "ENDSTATE":
+                    end = SVF_STATES[args.pop(0)]
+                elif args and args[0] == "TCK":
+                    # one TCK per microsecond, the player's idle rate
+                    us = max(us, int(float(a)))
+                    args.pop(0)
+                elif args and args[0] == "SEC":
+                    us = max(us, int(float(a)*1e6))
+                    args.pop(0)
+                elif a == "MAXIMUM":
+                    args = args[2:]
+            out.append(chr(XWAIT) + chr(state) + chr(end) + struct.pack(">L", us))
+        elif op == "STATE":
+            for s in words[1:]:
+                out.append(chr(XSTATE) + chr(SVF_STATES[s]))
+        elif op == "ENDIR":
+            endir = int(SVF_STATES[words[1]] != 1)
+            out.append(chr(XENDIR) + chr(endir))
+        elif op == "ENDDR":
+            enddr = int(SVF_STATES[words[1]] != 1)
+            out.append(chr(XENDDR) + chr(enddr))
+        elif op in ("HIR", "HDR", "TIR", "TDR"):
+            if int(words[1]) != 0:
+                raise Exception("%s padding is not supported" % op)
+        elif op in ("FREQUENCY", "TRST"):
+            pass
+        else:
+            raise Exception("Unsupported SVF statement: %s" % stmt.strip())
+
+    out.append(chr(XCOMPLETE))
+    return "".join(out)
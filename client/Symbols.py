@@ -0,0 +1,73 @@
+#!/usr/bin/env python
+# Symbol tables from ELF or GNU ld map files, for naming addresses
+
+import re, struct, bisect
+
+class Symbols:
+
+    """A sorted table of code symbols, loaded from an ELF file or a
+    GNU ld map file, that names the function around an address."""
+
+    def __init__(self, path=None):
+        self.syms = []
+        if path:
+            data = open(path, "rb").read()
+            if data[:4] == "\x7fELF":
+                self.elf(data)
+            else:
+                self.map(data)
+
+    def add(self, adr, name):
+        self.syms.append((adr, name))
+        self.syms.sort()
+
+    def elf(self, data):
+        """Load function and label symbols from a 32-bit ELF."""
+        endian = "<"
+        if data[5] == "\x02":
+            endian = ">"
+        shoff, = struct.unpack(endian + "L", data[0x20:0x24])
+        shentsize, shnum = struct.unpack(endian + "HH", data[0x2E:0x32])
+        sections = []
+        for i in range(shnum):
+            sh = data[shoff + i*shentsize:shoff + i*shentsize + 40]
+            sections.append(struct.unpack(endian + "10L", sh))
+        for name, kind, flags, adr, off, size, link, info, align, entsize in sections:
+            if kind != 2:  # SHT_SYMTAB
+                continue
+            stroff = sections[link][4]
+            for i in range(0, size, 16):
+                st_name, value, st_size, st_info, other, shndx = \
+                    struct.unpack(endian + "LLLBBH", data[off+i:off+i+16])
+                # functions, plus untyped labels in code from assembly
+                if shndx == 0 or shndx >= len(sections) or (st_info & 0xF) not in (0, 2):
+                    continue
+                if not sections[shndx][2] & 4:  # SHF_EXECINSTR
+                    continue
+                end = data.index("\0", stroff + st_name)
+                sym = data[stroff + st_name:end]
+                if sym and sym[0] not in ".$" and not sym.startswith("__"):
+                    self.syms.append((value, sym))
+        self.syms.sort()
+
+    def map(self, text):
+        """Load symbols from the address/name lines of a GNU ld map,
+        or the code-area lines of an SDCC map."""
+        for adr, sym in re.findall(r"(?m)^\s+0x([0-9a-fA-F]+)\s+([A-Za-z_]\w*)\s*$", text):
+            if not sym.startswith("__"):
+                self.syms.append((int(adr, 16), sym))
+        for adr, sym in re.findall(r"(?m)^\s+C:\s+([0-9a-fA-F]+)\s+(_\w+)", text):
+            # SDCC prefixes C names with an underscore
+            self.syms.append((int(adr, 16), sym[1:]))
+        self.syms.sort()
+
+    def span(self):
+        """The lowest and highest symbol addresses."""
+        return self.syms[0][0], self.syms[-1][0]
+
+    def lookup(self, adr):
+        """The (name, offset) of the symbol at or below an address."""
+        i = bisect.bisect_right(self.syms, (adr, "\xff")) - 1
+        if i < 0:
+            return ("0x%05x" % adr, 0)
+        return (self.syms[i][1], adr - self.syms[i][0])
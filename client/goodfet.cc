@@ -22,7 +22,9 @@ def printpacket(packet):
     print "# %s" %s;
 
 simplepacketcount=0;
-def handlesimplicitipacket(packet):
+def handlesimplicitipacket(packet,replies=1):
+    """Print a SimpliciTI packet, answering LINK and JOIN requests
+    from the host unless the target already does."""
     s="";
     i=0;
     global simplepacketcount;
@@ -59,6 +61,10 @@ def handlesimplicitipacket(packet):
         
         print "%09i %03i %4i %4i %4i" % (simplepacketcount,button,x,y,z);
         sys.stdout.flush();
+    elif port==0x02 and not replies:
+        print "# Link request answered by the target.";
+    elif port==0x03 and not replies:
+        print "# Join request answered by the target.";
     elif port==0x02:
         #Link request.  Gotta send a proper reply to get data.
         tid=packet[13];
@@ -115,14 +121,17 @@ if(len(sys.argv)==1):
     print "Usage: %s verb [objects]\n" % sys.argv[0];
     print "%s erase" % sys.argv[0];
     print "%s flash $foo.hex" % sys.argv[0];
+    print "%s reflash $foo.hex -- flashes only the pages that differ" % sys.argv[0];
     print "%s test" % sys.argv[0];
     print "%s term" % sys.argv[0];
     print "    use \'?\' for list of commands";
     print "%s info" % sys.argv[0];
+    print "%s tune [$delay] -- finds or sets the debug clock delay" % sys.argv[0];
     print "%s infotest" % sys.argv[0];
     print "%s radioinfo [help] [REGISTER_NAME]" % sys.argv[0];
     print "%s specfuncreg [SPECIAL_REGISTER_NAME]" % sys.argv[0];
     print "%s halt"  % sys.argv[0];
+    print "%s trace $steps [$foo.map [0x$lo 0x$hi]] -- instruction histogram by stepping" % sys.argv[0];
     print "%s regs" % sys.argv[0];
     print "%s dumpcode $foo.hex [0x$start 0x$stop]" % sys.argv[0];
     print "%s dumpdata $foo.hex [0x$start 0x$stop]" % sys.argv[0];
@@ -136,6 +145,7 @@ if(len(sys.argv)==1):
     print "\n"
     print "%s specan [freq]\n\tSpectrum Analyzer" % sys.argv[0];
     print "%s rssi [freq]\n\tGraphs signal strength on [freq] Hz." % sys.argv[0];
+    print "%s rssilog [freq] [count] [us] [threshold]\n\tSamples signal strength at a fixed rate, with duty cycle." % sys.argv[0];
     print "%s carrier [freq]\n\tHolds a carrier on [freq] Hz." % sys.argv[0];
     print "%s reflex [freq]\n\tJams on [freq] Hz." % sys.argv[0];
     print "%s sniffsimpliciti [us|eu|lf]\n\tSniffs SimpliciTI packets." % sys.argv[0];
@@ -147,6 +157,21 @@ if(len(sys.argv)==1):
     
     sys.exit();
 
+def sniffring():
+    """Sniff through the on-target receive ring, if rxring.ihx is built."""
+    if not client.RF_rxring():
+        return;
+    drops=0;
+    while 1:
+        time.sleep(0.1);
+        d,packets=client.RF_rxringdrain();
+        for ts,packet in packets:
+            printpacket(packet);
+        if d!=drops:
+            print "# %i packets dropped" % (d-drops);
+            drops=d;
+        sys.stdout.flush();
+
 #Initailize FET and set baud rate
 #client=GoodFET.GoodFETCC.GoodFETCC();
 client=GoodFETCC();
@@ -213,6 +238,39 @@ if(sys.argv[1]=="rssi"):
         for foo in range(0,rssi>>2):
             string=("%s."%string);
         print "%02x %04i %s" % (rssi,rssi, string); 
+if(sys.argv[1]=="rssilog"):
+    client.CC1110_crystal();
+    client.RF_idle();
+    
+    client.config_simpliciti();
+    
+    if len(sys.argv)>2:
+        client.RF_setfreq(eval(sys.argv[2]));
+    count=1000;
+    interval=1000;
+    threshold=None;
+    if len(sys.argv)>3:
+        count=int(sys.argv[3]);
+    if len(sys.argv)>4:
+        interval=int(sys.argv[4]);
+    if len(sys.argv)>5:
+        threshold=int(sys.argv[5]);
+    print "# Sampling %f MHz every %i us." % (client.RF_getfreq()/10.0**6,interval);
+    
+    client.CC_RFST_CAL();
+    time.sleep(1);
+    
+    samples=client.RF_rssisample(count,interval);
+    for i in range(len(samples)):
+        print "%i %i" % (i*interval,samples[i]);
+    
+    #Without a threshold, call the channel busy 10 above its floor.
+    if threshold==None:
+        threshold=min(samples)+10;
+    busy=len([x for x in samples if x>=threshold]);
+    print "# min %i mean %.1f max %i, busy %.1f%% of the time at >=%i" % (
+        min(samples),float(sum(samples))/len(samples),max(samples),
+        100.0*busy/len(samples),threshold);
 if(sys.argv[1]=="specan"):
     print "This doesn't work yet."
     
@@ -229,31 +287,46 @@ if(sys.argv[1]=="specan"):
     client.shellcodefile("specan.ihx",wait=0);
     #client.shellcodefile("crystal.ihx",wait=1);
     
-    bytestart=0xf800;
     maxchan=10;
     round=0;
+    last=None;
     
     print "time freq rssi";
     
     while 1:
-        time.sleep(1);
-        #client.CChaltcpu();
+        #Sweeps are double-buffered at 0xFE00 as
+        #[magic, seq, buf, min, max, freq[maxchan][3], ss[2][maxchan]].
+        client.CChaltcpu();
+        table=client.CCpeekdatablock(0xFE00,5+maxchan*5);
+        
+        if table[0]!=0x5A:
+            #Older specan.ihx halts after each sweep, with the channel
+            #table at 0xF800 in 8-byte entries.
+            chans=client.CCpeekdatablock(0xF800,maxchan*8);
+            client.CCreleasecpu();
+            round=round+1;
+            for entry in range(0,maxchan):
+                e=chans[entry*8:entry*8+8];
+                freq=(e[0]<<16)+(e[1]<<8)+e[2];
+                print "%03i %3.3f %03i" % (round,freq*396.728515625/10.0**6,e[6]);
+            sys.stdout.flush();
+            time.sleep(1);
+            continue;
         
+        client.CCreleasecpu();
+        seq=table[1];
+        if seq==last:
+            time.sleep(0.01);
+            continue;
+        last=seq;
         round=round+1;
         
-        dump="";
-        for entry in range(0,maxchan):
-            adr=bytestart+entry*8;
-            freq=((client.CCpeekdatabyte(adr+0)<<16)+
-                  (client.CCpeekdatabyte(adr+1)<<8)+
-                  (client.CCpeekdatabyte(adr+2)<<0));
-            hz=freq*396.728515625;
-            mhz=hz/1000000.0
-            rssi=client.CCpeekdatabyte(adr+6);
-            print "%03i %3.3f %03i" % (round,mhz,rssi);
-        print dump;
+        ss=table[5+maxchan*3+table[2]*maxchan:][:maxchan];
+        for ch in range(table[3],table[4]):
+            f=table[5+ch*3:8+ch*3];
+            freq=(f[0]<<16)+(f[1]<<8)+f[2];
+            print "%03i %3.3f %03i" % (round,freq*396.728515625/10.0**6,ss[ch]);
         sys.stdout.flush();
-        client.CCreleasecpu();
 
 
 if(sys.argv[1]=="sniff"):
@@ -265,6 +338,7 @@ if(sys.argv[1]=="sniff"):
     print "Listening as %x on %f MHz" % (client.RF_getsmac(),
                                            client.RF_getfreq()/10.0**6);
     #Now we're ready to get packets.
+    sniffring();
     while 1:
         packet=None;
         while packet==None:
@@ -285,6 +359,7 @@ if(sys.argv[1]=="sniffsimpliciti"):
     print "Listening as %x on %f MHz" % (client.RF_getsmac(),
                                            client.RF_getfreq()/10.0**6);
     #Now we're ready to get packets.
+    sniffring();
     while 1:
         packet=None;
         while packet==None:
@@ -384,6 +459,13 @@ if(sys.argv[1]=="simpliciti"):
     
     print "# Listening as %x on %f MHz" % (client.RF_getsmac(),
                                            client.RF_getfreq()/10.0**6);
+    #With simpliciti.ihx built, the target answers in time by itself.
+    if client.RF_simpliciti_ap():
+        while 1:
+            time.sleep(0.1);
+            drops,packets=client.RF_rxringdrain();
+            for ts,packet in packets:
+                handlesimplicitipacket(packet,replies=0);
     #Now we're ready to get packets.
     while 1:
         packet=None;
@@ -410,15 +492,7 @@ if(sys.argv[1]=="dumpcode"):
     if(len(sys.argv)>4):
         stop=int(sys.argv[4],16);
     
-    print "Dumping code from %04x to %04x as %s." % (start,stop,f);
-    h = IntelHex(None);
-    i=start;
-    while i<=stop:
-        h[i]=client.CCpeekcodebyte(i);
-        if(i%0x100==0):
-            print "Dumped %04x."%i;
-        i+=1;
-    h.write_hex_file(f);
+    client.dump(f,start,stop);
 if(sys.argv[1]=="dumpdata"):
     f = sys.argv[2];
     start=0xE000;
@@ -593,14 +667,54 @@ if(sys.argv[1]=="verify"):
     if(len(sys.argv)>4):
         stop=int(sys.argv[4],16);
     
+    #Compare page CRCs, then only read back the pages that differ.
     h = IntelHex(f);
-    for i in h._buf.keys():
-        if(i>=start and i<stop):
-            peek=client.CCpeekcodebyte(i)
-            if(h[i]!=peek):
-                print "ERROR at %04x, found %02x not %02x"%(i,peek,h[i]);
-            if(i%0x100==0):
-                print "%04x" % i;
+    pagelen=client.CCpagesize();
+    bad=client.verifypages(f);
+    for page in bad:
+        peek=client.CCpeekcodeblock(page,pagelen);
+        for i in range(page,page+pagelen):
+            if(h._buf.has_key(i) and i>=start and i<stop
+               and h[i]!=peek[i-page]):
+                print "ERROR at %04x, found %02x not %02x"%(i,peek[i-page],h[i]);
+    print "%i pages differ." % len(bad);
+if(sys.argv[1]=="tune"):
+    if(len(sys.argv)>2):
+        delay=client.CCclockdelay(int(sys.argv[2]));
+    else:
+        delay=client.CCautotune();
+    if delay==0xFFFF:
+        print "No stable debug clock; delay left at %i." % client.CCclockdelay();
+    else:
+        print "Debug clock delay is %i." % delay;
+if(sys.argv[1]=="trace"):
+    from Symbols import Symbols;
+    steps=int(sys.argv[2]);
+    syms=Symbols();
+    if(len(sys.argv)>3):
+        syms=Symbols(sys.argv[3]);
+    lo=hi=0;
+    if(len(sys.argv)>5):
+        lo=int(sys.argv[4],16);
+        hi=int(sys.argv[5],16);
+    
+    hist={};
+    n=0;
+    for rec in client.CCtrace(steps,lo,hi):
+        name,off=syms.lookup(rec[0]);
+        hist[name]=hist.get(name,0)+1;
+        n+=1;
+        if n%1000==0:
+            sys.stderr.write("\r%i/%i steps" % (n,steps));
+    sys.stderr.write("\n");
+    
+    ranked=[(hist[name],name) for name in hist.keys()];
+    ranked.sort();
+    ranked.reverse();
+    for count,name in ranked:
+        print "%6.2f%% %8i %s" % (100.0*count/max(n,1),count,name);
+if(sys.argv[1]=="reflash"):
+    client.flash(sys.argv[2],incremental=1);
 if(sys.argv[1]=="peekcode"):
     start=0x0000;
     if(len(sys.argv)>2):
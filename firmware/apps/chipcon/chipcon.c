@@ -81,6 +81,10 @@ app_t const chipcon_app = {
 //#define CCDELAY(x) delay_ms(x)
 #define CCDELAY(x)
 
+//! Extra delay() count in each DC half period, 0 for full speed.
+u16 cc_clk_delay=0;
+#define CCWAIT if(cc_clk_delay) delay(cc_clk_delay)
+
 #define SETMOSI SPIOUT|=MOSI
 #define CLRMOSI SPIOUT&=~MOSI
 #define SETCLK SPIOUT|=SCK
@@ -174,12 +178,27 @@ void ccdebuginit(){
 
 //! Read and write a CC bit.
 unsigned char cctrans8(unsigned char byte){
-  unsigned int bit;
+  unsigned char bit;
   //This function came from the SPI Wikipedia article.
   //Minor alterations.
 
+  /* At full speed, skip the delay tests; the port writes alone hold
+     DC high and low for longer than the chip's minimum. */
+  if(!cc_clk_delay){
+    for (bit = 0; bit < 8; bit++) {
+      if (byte & 0x80)
+	SETMOSI;
+      else
+	CLRMOSI;
+      byte <<= 1;
+      SETCLK;
+      byte |= READMISO;
+      CLRCLK;
+    }
+    return byte;
+  }
+
   for (bit = 0; bit < 8; bit++) {
-    CCDELAY(CCSPEED>>2);
     /* write MOSI on trailing edge of previous clock */
     if (byte & 0x80)
       SETMOSI;
@@ -188,11 +207,11 @@ unsigned char cctrans8(unsigned char byte){
     byte <<= 1;
 
     /* half a clock cycle before leading/rising edge */
-    CCDELAY(CCSPEED>>2);
+    CCWAIT;
     SETCLK;
 
     /* half a clock cycle before trailing/falling edge */
-    CCDELAY(CCSPEED>>2);
+    CCWAIT;
 
     /* read MISO on trailing edge */
     byte |= READMISO;
@@ -202,6 +221,57 @@ unsigned char cctrans8(unsigned char byte){
   return byte;
 }
 
+//! Reference chip ID from the last auto-tune
+static u16 cc_tune_id;
+
+//! Do repeated exchanges at this delay all read back correctly?
+static u8 cc_tune_stable(u16 clkdelay, u8 iterations){
+  u8 pattern=0x5A;
+
+  cc_clk_delay=clkdelay;
+  while(iterations--){
+    if(cc_get_chip_id()!=cc_tune_id)
+      return 0;
+    //MOV A, #pattern echoes the pattern back through DD.
+    if(cc_debug(2, 0x74, pattern, 0)!=pattern)
+      return 0;
+    pattern=(pattern<<1)|(((pattern>>7)^(pattern>>5))&1);
+  }
+  return 1;
+}
+
+/* Binary-search the shortest DC delay at which the chip ID and echoed
+   accumulator patterns match a reference read at the slowest delay.
+   Leaves the result in cc_clk_delay, or returns 0xFFFF with the old
+   delay kept if even the slowest is not stable.  A is restored, so
+   the halted target doesn't notice.
+*/
+u16 cc_autotune(u8 iterations, u16 slowest){
+  u16 lo=0, hi=slowest, mid, old=cc_clk_delay;
+  u8 a;
+
+  cc_clk_delay=slowest;
+  cc_tune_id=cc_get_chip_id();
+  //A NOP returns A.
+  a=cc_debug(1, 0x00, 0, 0);
+  if(!cc_tune_stable(slowest, iterations)){
+    cc_clk_delay=old;
+    cc_debug(2, 0x74, a, 0);
+    return 0xFFFF;
+  }
+
+  while(lo<hi){
+    mid=(lo+hi)>>1;
+    if(cc_tune_stable(mid, iterations))
+      hi=mid;
+    else
+      lo=mid+1;
+  }
+  cc_clk_delay=hi;
+  cc_debug(2, 0x74, a, 0);
+  return hi;
+}
+
 //! Send a command from txbytes.
 void cccmd(unsigned char len){
   unsigned char i;
@@ -324,11 +394,17 @@ void cc_handle_fn( uint8_t const app,
     cmddata[0]=cc_peekcodebyte(cmddataword[0]);
     txdata(app,verb,1);
     break;
+  case CC_READ_CODE_BLOCK:
+    //32-bit address, 16-bit length.
+    cc_readcodeblock(app,verb,cmddatalong[0],cmddataword[2]);
+    break;
   case CC_READ_XDATA_MEMORY:
     //Read the length.
     blocklen=1;
     if(len>2)
       blocklen=cmddataword[1];
+    if(blocklen>CMDDATALEN)
+      blocklen=CMDDATALEN;
     blockadr=cmddataword[0];
 
     //Return that many bytes.
@@ -341,6 +417,37 @@ void cc_handle_fn( uint8_t const app,
     cmddata[0]=cc_pokedatabyte(cmddataword[0], cmddata[2]);
     txdata(app,verb,1);
     break;
+  case CC_WRITE_XDATA_BLOCK:
+    //16-bit address, then the bytes to write.
+    cc_write_xdata(cmddataword[0], cmddata+2, len>2 ? len-2 : 0);
+    txdata(app,verb,0);
+    break;
+  case CC_CLOCK_DELAY:
+    //Set the DC delay if given, and return it.
+    if(len>=2)
+      cc_clk_delay=cmddataword[0];
+    cmddataword[0]=cc_clk_delay;
+    txdata(app,verb,2);
+    break;
+  case CC_AUTOTUNE:
+    //[iterations, pad, slowest16]; returns the delay.
+    cmddataword[0]=cc_autotune(len>=1 ? cmddata[0] : CC_TUNE_ITERATIONS,
+			       len>=4 ? cmddataword[1] : CC_TUNE_SLOWEST);
+    txdata(app,verb,2);
+    break;
+  case CC_SAMPLE_XDATA:
+    //16-bit address, interval in us and count; one byte per sample.
+    blocklen=cmddataword[2];
+    if(blocklen>CMDDATALEN)
+      blocklen=CMDDATALEN;
+    cc_sample_xdata(cmddataword[0], cmddataword[1], blocklen);
+    txdata(app,verb,blocklen);
+    break;
+  case CC_TRACE:
+    //32-bit step count, 16-bit PC range, 16-bit flags.
+    cc_trace(app,verb,cmddatalong[0],cmddataword[2],cmddataword[3],
+	     cmddata[8]&CC_TRACE_REGS);
+    break;
   case CC_SET_PC:
     cc_set_pc(cmddatalong[0]);
     txdata(app,verb,0);
@@ -349,6 +456,13 @@ void cc_handle_fn( uint8_t const app,
     cc_write_flash_page(cmddatalong[0]);
     txdata(app,verb,0);
     break;
+  case CC_WRITE_FLASH_DMA:
+    //32-bit address, 16-bit XDATA scratch, 16-bit flags, then data.
+    cmddata[0]=cc_write_flash_dma(cmddatalong[0], cmddataword[2],
+				  cmddata[6]&1,
+				  cmddata+8, len>8 ? len-8 : 0);
+    txdata(app,verb,1);
+    break;
   case CC_WIPEFLASHBUFFER:
     for(i=0xf000;i<0xf800;i++)
       cc_pokedatabyte(i,0xFF);
@@ -463,9 +577,16 @@ void cc_write_flash_buffer(u8 *data, u16 len){
 //! Populates flash buffer in xdata.
 void cc_write_xdata(u16 adr, u8 *data, u16 len){
   u16 i;
+
+  //MOV DPTR, adr
+  cc_debug(3, 0x90, adr>>8, adr&0xFF);
   for(i=0; i<len; i++){
-    cc_pokedatabyte(adr+i,
-		    data[i]);
+    //MOV A, val
+    cc_debug(2, 0x74, data[i], 0);
+    //MOVX @DPTR, A
+    cc_debug(1, 0xF0, 0, 0);
+    //INC DPTR
+    cc_debug(1, 0xA3, 0, 0);
   }
 }
 
@@ -594,6 +715,101 @@ void cc_write_flash_page(u32 adr){
   led_off();
 }
 
+//! Wait out a CC253x flash operation, returning FCTL.
+static u8 cc_flash_wait(){
+  u16 i;
+  u8 fctl;
+
+  for(i=0; i<0xFFFF; i++){
+    fctl=cc_peekdatabyte(CC253X_FCTL);
+    if(!(fctl&CC253X_FCTL_BUSY))
+      return fctl;
+    led_toggle();
+  }
+  led_off();
+  return fctl;
+}
+
+//! Point the flash controller at a byte address.
+static void cc_flash_addr(u32 adr){
+  //FADDR counts 32-bit words.
+  cc_pokedatabyte(CC253X_FADDRL, (adr>>2)&0xFF);
+  cc_pokedatabyte(CC253X_FADDRH, (adr>>10)&0xFF);
+}
+
+/* The debug interface's BURST_WRITE clocks bytes into DBGDATA, each
+   one a DBG_BW trigger for DMA.  Channel 0 copies them into an XDATA
+   buffer, then channel 1 feeds that buffer to FWDATA on the flash
+   controller's own trigger, so the page is written without running
+   any code on the target.  This is the method of SWRA124 for the
+   CC253x family; the older parts lack BURST_WRITE and use
+   cc_write_flash_page() instead.
+
+   The write is left running on return, overlapping the next block's
+   transfer from the host; each call first waits out the last, and
+   returns the FCTL value that it finished with.  A call with no data
+   just waits.
+*/
+
+//! Write a block of flash through BURST_WRITE and DMA, on CC253x.
+u8 cc_write_flash_dma(u32 adr, u16 buf, u8 erase, u8 *data, u16 len){
+  u8 desc[16];
+  u16 dst=buf+sizeof(desc);
+  u8 fctl;
+  u16 i;
+
+  fctl=cc_flash_wait();
+  if(!len)
+    return fctl;
+  if((adr|len)&3 || len>0x7FF){
+    debugstr("DMA flash writes must be whole words, under 2kB.");
+    return CC253X_FCTL_ABORT;
+  }
+
+  //Channel 0: DBGDATA to the buffer, one byte per DBG_BW.
+  desc[0]=CC253X_DBGDATA>>8;  desc[1]=CC253X_DBGDATA&0xFF;
+  desc[2]=dst>>8;             desc[3]=dst&0xFF;
+  desc[4]=len>>8;             desc[5]=len&0xFF;
+  desc[6]=CC_DMA_TRIG_DBG_BW; desc[7]=0x11; //DESTINC, normal priority
+  //Channel 1: the buffer to FWDATA, one byte per FLASH trigger.
+  desc[8]=dst>>8;             desc[9]=dst&0xFF;
+  desc[10]=CC253X_FWDATA>>8;  desc[11]=CC253X_FWDATA&0xFF;
+  desc[12]=len>>8;            desc[13]=len&0xFF;
+  desc[14]=CC_DMA_TRIG_FLASH; desc[15]=0x42; //SRCINC, high priority
+  cc_write_xdata(buf, desc, sizeof(desc));
+
+  //MOV DMA0CFGH/L, buf;  MOV DMA1CFGH/L, buf+8
+  cc_debug(3, 0x75, 0xD5, buf>>8);
+  cc_debug(3, 0x75, 0xD4, buf&0xFF);
+  cc_debug(3, 0x75, 0xD3, (buf+8)>>8);
+  cc_debug(3, 0x75, 0xD2, (buf+8)&0xFF);
+
+  if(erase){
+    cc_flash_addr(adr);
+    cc_pokedatabyte(CC253X_FCTL, CC253X_FCTL_ERASE);
+    fctl=cc_flash_wait();
+    if(fctl&CC253X_FCTL_ABORT)
+      return fctl;
+  }
+
+  //MOV DMAARM, #1
+  cc_debug(3, 0x75, 0xD6, 0x01);
+  CCWRITE;
+  cctrans8(CCCMD_BURST_WRITE|((len>>8)&0x07));
+  cctrans8(len&0xFF);
+  for(i=0; i<len; i++)
+    cctrans8(data[i]);
+  CCREAD;
+  cctrans8(0);
+
+  cc_flash_addr(adr);
+  //MOV DMAARM, #2
+  cc_debug(3, 0x75, 0xD6, 0x02);
+  cc_pokedatabyte(CC253X_FCTL, CC253X_FCTL_WRITE);
+
+  return cc_peekdatabyte(CC253X_FCTL);
+}
+
 //! Read the PC
 unsigned short cc_get_pc(){
   cmddata[0]=CCCMD_GET_PC; //0x28
@@ -638,6 +854,94 @@ void cc_step_instr(){
   return;
 }
 
+/* Samples are paced by Timer B deadlines, start to start, so the time
+   taken by each read doesn't add to the interval.  Long intervals are
+   waited out a millisecond at a time to keep each deadline within the
+   16-bit timer's reach.  Useful for RSSI, which the radio updates in
+   XDATA while receiving.
+*/
+
+//! Sample a byte of XDATA at a fixed interval into cmddata.
+void cc_sample_xdata(u16 adr, u16 interval, u16 count){
+  u16 i, left;
+#if defined(MSP430) && (platform != tilaunchpad)
+  u16 next;
+
+  prep_timer();
+  TBCTL|=0x20; //Start timer, continuous at 16 ticks/us.
+  next=TBR;
+  for(i=0;i<count;i++){
+    cmddata[i]=cc_peekdatabyte(adr);
+    for(left=interval; left; ){
+      u16 us=left>1000 ? 1000 : left;
+      left-=us;
+      next+=us<<4;
+      while((int)(TBR-next)<0);
+    }
+  }
+  TBCTL=0x0204; //Reset Timer B, till next time
+#else
+  //No Timer B helpers here, so only roughly paced.
+  for(i=0;i<count;i++){
+    cmddata[i]=cc_peekdatabyte(adr);
+    for(left=interval; left; left--)
+      delay(1);
+  }
+#endif
+}
+
+/* A trace is a run of records, each the PC after a step, little
+   endian, then A and SP when asked for.  Records collect in cmddata
+   and go out as a CC_TRACE packet each time it fills, so the host can
+   take any number of steps in one command.  An OK packet ends the
+   trace with the count of steps taken.
+
+   Tracing stops early when the PC leaves [lo,hi), unless hi is zero.
+*/
+
+//! Single-step the target, streaming a trace of its PC.
+void cc_trace(u8 app, u8 verb, u32 count, u16 lo, u16 hi, u8 regs){
+  u16 n=0, size=regs ? 4 : 2;
+  u32 steps=0;
+  u16 pc;
+  u8 a;
+
+  while(steps<count){
+    //STEP_INSTR and GET_PC by hand, as cccmd() would clobber cmddata.
+    CCWRITE;
+    cctrans8(CCCMD_STEP_INSTR);
+    CCREAD;
+    cctrans8(0);
+    steps++;
+    CCWRITE;
+    cctrans8(CCCMD_GET_PC);
+    CCREAD;
+    pc=cctrans8(0)<<8;
+    pc|=cctrans8(0);
+
+    cmddata[n++]=pc&0xFF;
+    cmddata[n++]=pc>>8;
+    if(regs){
+      //A NOP returns A, then MOV A, SP and restore A.
+      a=cc_debug(1, 0x00, 0, 0);
+      cmddata[n++]=a;
+      cmddata[n++]=cc_debug(2, 0xE5, 0x81, 0);
+      cc_debug(2, 0x74, a, 0);
+    }
+    if(n+size>CMDDATALEN){
+      txdata(app,verb,n);
+      n=0;
+    }
+    if(hi && (pc<lo || pc>=hi))
+      break;
+  }
+  if(n)
+    txdata(app,verb,n);
+
+  cmddatalong[0]=steps;
+  txdata(app,OK,4);
+}
+
 //! Debug an instruction.
 void cc_debug_instr(unsigned char len){
   //Bottom two bits of command indicate length.
@@ -667,29 +971,50 @@ unsigned char cc_debug(unsigned char len,
   return cctrans8(0x00);
 }
 
-//! Fetch a byte of code memory.
-unsigned char cc_peekcodebyte(unsigned long adr){
+//! Map a code address's bank and point DPTR at it.
+static void cc_codeptr(unsigned long adr){
   /** See page 9 of SWRA124 */
-  unsigned char bank=adr>>15,
-    lb=adr&0xFF,
-    hb=(adr>>8)&0x7F,
-    toret=0;
+  unsigned char bank=adr>>15;
+
+  /* The lower 32kB is always bank 0, while MEMCTR maps the selected
+     bank into the upper 32kB. */
   adr&=0x7FFF;
+  if(bank)
+    adr|=0x8000;
 
   //MOV MEMCTR, (bank*16)+1
   cc_debug(3, 0x75, 0xC7, (bank<<4) + 1);
   //MOV DPTR, address
-  cc_debug(3, 0x90, hb, lb);
+  cc_debug(3, 0x90, (adr>>8)&0xFF, adr&0xFF);
+}
+
+//! Fetch a byte of code memory.
+unsigned char cc_peekcodebyte(unsigned long adr){
+  cc_codeptr(adr);
 
-  //for each byte
   //CLR A
   cc_debug(2, 0xE4, 0, 0);
   //MOVC A, @A+DPTR;
-  toret=cc_debug(3, 0x93, 0, 0);
-  //INC DPTR
-  //cc_debug(1, 0xA3, 0, 0);
+  return cc_debug(3, 0x93, 0, 0);
+}
 
-  return toret;
+//! Stream a block of code memory to the host.
+void cc_readcodeblock(u8 app, u8 verb, u32 adr, u16 len){
+  txhead(app,verb,len);
+
+  cc_codeptr(adr);
+  while(len--){
+    //CLR A
+    cc_debug(2, 0xE4, 0, 0);
+    //MOVC A, @A+DPTR;
+    serial_tx(cc_debug(3, 0x93, 0, 0));
+    //INC DPTR
+    cc_debug(1, 0xA3, 0, 0);
+
+    //Remap at each bank boundary.
+    if(!(++adr&0x7FFF) && len)
+      cc_codeptr(adr);
+  }
 }
 
 
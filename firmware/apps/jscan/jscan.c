@@ -17,7 +17,20 @@
 #include "jscan.h"
 
 #define OFFSETIO 32
-#define NPATTERN 64
+#define NPATTERN 32
+#define NPORTS 8
+
+/* TMS sequences, LSB first, from anywhere */
+#define TAP_SHIFTIR	0x0df	/* reset, idle, select-dr, select-ir, capture-ir, shift-ir */
+#define TAP_SHIFTIR_LEN	10
+#define TAP_SHIFTDR	0x05f	/* reset, idle, select-dr, capture-dr, shift-dr */
+#define TAP_SHIFTDR_LEN	9
+
+/* longest total IR length searched for the TDI pattern */
+#define MAXIR		64
+
+/* no pin, in hits and results */
+#define NOPIN		0xff
 
 typedef struct Pin Pin;
 
@@ -29,6 +42,8 @@ Pin
 	uint8_t id;
 	uint8_t bit;
 	uint8_t pullup;
+	uint8_t inport;		/* index into inports */
+	uint32_t word;		/* TDO samples, first in bit 0 */
 	volatile uint8_t * ddr;
 	volatile uint8_t * pin;
 	volatile uint8_t * port;
@@ -37,10 +52,11 @@ Pin
 static Pin * pins;
 static int nfound;
 static uint8_t found[CMDDATALEN];
-static char * tap_shiftir = "1111101100";
 static uint8_t xdelay = JSCAN_DEFAULT_DELAY;
 static uint8_t endian = JSCAN_ENDIAN_LITTLE;
-static char pattern[NPATTERN] = "0110011101001101101000010111001001";
+static uint32_t pattern = 0x4e85b2e6;	/* 01100111010011011010000101110010, LSB first */
+static volatile uint8_t * inports[NPORTS];
+static uint8_t ninports;
 
 static void jscan(uint8_t, uint8_t, uint32_t);
 
@@ -58,11 +74,19 @@ static uint8_t findpin(uint8_t, Pin ** );
 static void scan(uint8_t);
 static void loopback(uint8_t);
 static void getresults(uint8_t);
+static void jtick(void);
+static uint8_t pinread(Pin * );
+static uint8_t portmap(void);
+static void sampleall(void);
 static void clockstrobe(Pin * );
 static void tdipulse(Pin *, Pin *, uint8_t);
-static void tapstate(char *, Pin *, Pin * );
+static void tapstate(uint16_t, uint8_t, Pin *, Pin * );
 static void initpins(Pin *, Pin *, Pin *, Pin *, Pin * );
-static int checkdata(char *, int, Pin *, Pin *, Pin *, int * );
+static int checkdata(uint32_t, int, Pin *, Pin *, Pin *, int * );
+static uint8_t isidcode(uint32_t);
+static void idscan(Pin *, Pin *, Pin * );
+static Pin * tdiscan(Pin *, Pin *, Pin *, Pin * );
+static void hit(uint8_t, Pin *, Pin *, Pin *, Pin *, Pin *, uint32_t);
 
 app_t const 
 jscan_app = 
@@ -357,116 +381,151 @@ initpins(Pin * tck, Pin * tms, Pin * tdi, Pin * tdo, Pin * nrst)
 {
 	Pin * p;
 
-/* XXX test removing syncs */
 	p = pins;
 	while(p)
 	{
 		/* set as input by default */
 		*p->ddr &= ~(1 << p->bit);
 
-		/* sync */
-		_delay_ms(xdelay);
-
 		/* set pullup if desired while in input mode */
 		if(p->pullup)
 			*p->port |= (1 << p->bit);
 		else
 			*p->port &= ~(1 << p->bit);
 
-		/* sync */
-		_delay_ms(xdelay);
-
 		if(p == nrst)
 		{
-			/* set as output */
-			*p->ddr |= (1 << p->bit);
-
 			/* nrst requires output fixed high */
-			*p->port &= ~(1 << p->bit);
 			*p->port |=  (1 << p->bit);
+
+			/* set as output */
+			*p->ddr |= (1 << p->bit);
 		}
 		else if(p == tck || p == tms || p == tdi)
 		{
+			/* these pins must start low */
+			*p->port &= ~(1 << p->bit);
+
 			/* set as output */
 			*p->ddr |= (1 << p->bit);
+		}
 
-			/* sync */
-			_delay_ms(xdelay);
+		/* tdo should need no special sauce */
 
-			/* these pins must start low */
-			*p->port &= ~(1 << p->bit);
+		p = p->next;
+	}
+
+	/* one sync for the lot, pullups need a moment */
+	_delay_ms(1);
+}
+
+/* half a TCK period; xdelay is in microseconds */
+static void
+jtick(void)
+{
+	uint8_t i;
+
+	for(i = 0; i < xdelay; i++)
+		_delay_us(1);
+}
+
+static uint8_t
+pinread(Pin * p)
+{
+	return (*p->pin >> p->bit) & 1;
+}
+
+/* collect the distinct input registers, so that one read of each samples every pin */
+static uint8_t
+portmap(void)
+{
+	uint8_t i;
+	Pin * p;
+
+	ninports = 0;
+	p = pins;
+	while(p)
+	{
+		for(i = 0; i < ninports; i++)
+			if(inports[i] == p->pin)
+				break;
+		if(i == ninports)
+		{
+			if(ninports == NPORTS)
+				return NMEM;
+			inports[ninports++] = p->pin;
 		}
+		p->inport = i;
+		p = p->next;
+	}
 
-		/* tdo should need no special sauce */
+	return OK;
+}
+
+/* shift the current level of every pin into its word */
+static void
+sampleall(void)
+{
+	uint8_t snap[NPORTS];
+	uint8_t i;
+	Pin * p;
 
-		/* sync */
-		_delay_ms(xdelay);
+	for(i = 0; i < ninports; i++)
+		snap[i] = *inports[i];
 
+	p = pins;
+	while(p)
+	{
+		p->word >>= 1;
+		if(snap[p->inport] & (1 << p->bit))
+			p->word |= 0x80000000UL;
 		p = p->next;
 	}
 }
 
+/* bit-packed match: a 32-bit window of TDO against the pattern clocked into TDI */
 static int
-checkdata(char * pattern, int ntimes, Pin * tck, Pin * tdi, Pin * tdo, int * nreg)
+checkdata(uint32_t pattern, int ntimes, Pin * tck, Pin * tdi, Pin * tdo, int * nreg)
 {
-        char rcv[NPATTERN];
-        int tdo_read;
-        int tdo_prev;
-        int ntoggle;
-        uint8_t x;
-        int np;
-        int i;
-        int w;
-
-        w = 0;
-        np = strlen(pattern);
-
-        x = (*tdo->pin & (1 << tdo->bit)) >> tdo->bit;
-
-        tdo_prev = '0' + (x == 1);
-
-        for(i = 0; i < ntimes; i++)
-        {
-                tdipulse(tck, tdi, pattern[w++] - '0');
-                if(!pattern[w])
-                {
-                        w = 0;
-                }
-
-                x = (*tdo->pin & (1 << tdo->bit)) >> tdo->bit;
-
-                tdo_read = '0' + (x == 1);
-
-                ntoggle += (tdo_read != tdo_prev);
-                tdo_prev = tdo_read;
-
-                if(i < np)
-                {
-                        rcv[i] = tdo_read;
-                }
-                else
-                {
-                        memmove(rcv, rcv + 1, np - 1);
-                        rcv[np - 1] = tdo_read;
-                }
-
-                if(i >= np - 1)
-                {
-                        if(!memcmp(pattern, rcv, np))
-                        {
-                                if(nreg)
-                                        *nreg = i + 1 - np;
-                                return 1;
-                        }
-                }
-        }
-
-        if(nreg)
-                *nreg = 0;
-
-        return ntoggle > 1 ? ntoggle : 0 ;
+	uint32_t rcv;
+	uint8_t tdo_read;
+	uint8_t tdo_prev;
+	int ntoggle;
+	int i;
+
+	rcv = 0;
+	ntoggle = 0;
+	tdo_prev = pinread(tdo);
+
+	for(i = 0; i < ntimes; i++)
+	{
+		/* the pattern repeats, so a match lines up with its start */
+		tdipulse(tck, tdi, (pattern >> (i & (NPATTERN - 1))) & 1);
+
+		tdo_read = pinread(tdo);
+
+		ntoggle += (tdo_read != tdo_prev);
+		tdo_prev = tdo_read;
+
+		rcv >>= 1;
+		if(tdo_read)
+			rcv |= 0x80000000UL;
+
+		if(i >= NPATTERN - 1 && rcv == pattern)
+		{
+			if(nreg)
+				*nreg = i + 1 - NPATTERN;
+			return 1;
+		}
+	}
+
+	if(nreg)
+		*nreg = 0;
+
+	return ntoggle > 1 ? ntoggle : 0 ;
 }
 
+/* TDI is set with TCK low, sampled by the target on the rising edge; TDO is read after the falling edge */
 static void
 tdipulse(Pin * tck, Pin * tdi, uint8_t x)
 {
@@ -476,7 +535,7 @@ tdipulse(Pin * tck, Pin * tdi, uint8_t x)
 		*tdi->port &= ~(1 << tdi->bit);
 
 	/* sync */
-	_delay_ms(xdelay);
+	jtick();
 
 	clockstrobe(tck);
 }
@@ -484,136 +543,201 @@ tdipulse(Pin * tck, Pin * tdi, uint8_t x)
 static void
 clockstrobe(Pin * tck)
 {
-	*tck->port |= (1 << tck->bit);
-	_delay_ms(xdelay);
+	/* loopback has no clock, only the delay */
+	if(tck)
+		*tck->port |= (1 << tck->bit);
+	jtick();
+
+	if(tck)
+		*tck->port &= ~(1 << tck->bit);
+	jtick();
+}
 
-	*tck->port &= ~(1 << tck->bit);
-	_delay_ms(xdelay);
+/* IDCODE has bit 0 set and a JEP106 identity other than 0x7f */
+static uint8_t
+isidcode(uint32_t w)
+{
+	if(!(w & 1) || w == 0xffffffffUL)
+		return 0;
+	if(((w >> 1) & 0x7f) == 0x7f)
+		return 0;
+	return 1;
 }
 
+/* reset the TAP, which loads IDCODE into DR, and shift out 32 bits, sampling every pin at once */
+static void
+idscan(Pin * tck, Pin * tms, Pin * nrst)
+{
+	uint8_t i;
+	Pin * p;
+
+	initpins(tck, tms, NULL, NULL, nrst);
+	tapstate(TAP_SHIFTDR, TAP_SHIFTDR_LEN, tck, tms);
+
+	p = pins;
+	while(p)
+	{
+		p->word = 0;
+		p = p->next;
+	}
+
+	/* shift-dr already presents bit 0 */
+	sampleall();
+	for(i = 1; i < 32; i++)
+	{
+		clockstrobe(tck);
+		sampleall();
+	}
+}
+
+/* with TCK, TMS and TDO known, only TDI is left; find it through the IR */
+static Pin *
+tdiscan(Pin * tck, Pin * tms, Pin * tdo, Pin * nrst)
+{
+	Pin * tdi;
+
+	tdi = pins;
+	while(tdi)
+	{
+		if(tdi != nrst && tdi != tck && tdi != tms && tdi != tdo)
+		{
+			initpins(tck, tms, tdi, tdo, nrst);
+			tapstate(TAP_SHIFTIR, TAP_SHIFTIR_LEN, tck, tms);
+
+			if(checkdata(pattern, NPATTERN + MAXIR, tck, tdi, tdo, NULL) == 1)
+				return tdi;
+		}
+
+		tdi = tdi->next;
+	}
+
+	return NULL;
+}
+
+/* record a hit for getresults, and stream it with its IDCODE */
+static void
+hit(uint8_t a, Pin * tck, Pin * tms, Pin * tdi, Pin * tdo, Pin * nrst, uint32_t id)
+{
+	uint8_t r[5];
+
+	/* order is important */
+	r[0] = tck->id;
+	r[1] = tms->id;
+	r[2] = tdi ? tdi->id : NOPIN;
+	r[3] = tdo->id;
+	r[4] = nrst ? nrst->id : NOPIN;
+
+	if(nfound < (CMDDATALEN-4)-5)
+	{
+		memcpy(found + nfound, r, 5);
+		nfound += 5;
+	}
+
+	memcpy(cmddata, r, 5);
+	cmddata[5] = id & 0xff;
+	cmddata[6] = (id >> 8) & 0xff;
+	cmddata[7] = (id >> 16) & 0xff;
+	cmddata[8] = (id >> 24) & 0xff;
+	txdata(a, JSCAN_CMD_HIT, 9);
+}
+
+/*
+ * Rather than trying every nrst/tck/tms/tdo/tdi permutation:
+ *  - for each tck/tms pair, reset the TAP into IDCODE and shift it out,
+ *    sampling every other pin as a TDO candidate at once;
+ *  - only for a TDO giving a plausible IDCODE, look for TDI by
+ *    clocking a pattern through the IR;
+ *  - nrst is left floating, and each pin is only tried as nrst if
+ *    that found nothing.
+ * Targets with no IDCODE (BYPASS after reset) are not found this way.
+ */
 static void
 scan(uint8_t a)
 {
 	Pin * nrst;
 	Pin * tck;
 	Pin * tms;
-	Pin * tdi;
 	Pin * tdo;
-	int nreg;
-	int r;
+	uint8_t itck;
 
-        if(npins() < 5)
-        {
-                txdata(a, EXIST, 0);
-                return;
-        }
+	if(npins() < 4)
+	{
+		txdata(a, EXIST, 0);
+		return;
+	}
+
+	if(portmap() != OK)
+	{
+		txdata(a, NMEM, 0);
+		return;
+	}
 
 	nfound = 0;
-        nrst = pins;
+	nrst = NULL;
 
 	/* send back an OK to let the user know we've started */
 	txdata(a, OK, 0);
 
-        while(nrst)
-        {
-                tck = pins;
-                while(tck)
-                {
-                        if(tck == nrst)
-                        {
-                                tck = tck->next;
-                                continue;
-                        }
-
-                        tms = pins;
-                        while(tms)
-                        {
-                                if(tms == nrst || tms == tck)
-                                {
-                                        tms = tms->next;
-                                        continue;
-                                }
-
-                                tdo = pins;
-                                while(tdo)
-                                {
-                                        if(tdo == nrst || tdo == tck || tdo == tms)
-                                        {
-                                                tdo = tdo->next;
-                                                continue;
-                                        }
-
-                                        tdi = pins;
-                                        while(tdi)
-                                        {
-                                                if(tdi == nrst || tdi == tck || tdi == tms || tdi == tdo)
-                                                {
-                                                        tdi = tdi->next;
-                                                        continue;
-                                                }
-
-                                                initpins(tck, tms, tdi, tdo, nrst);
-
-                                                tapstate(tap_shiftir, tck, tms);
-
-                                                r = checkdata(pattern, (2*NPATTERN), tck, tdi, tdo, &nreg);
-                                                if(r == 1)
-                                                {
-							/* found potential JTAG */
-							/* NB */
-							/* can fit around 100 detections; but total should hover around 0.5% of total tests. 
-							 * so if the number of tests is really high, one could exceed 100 detected JTAGs,
-							 * so caveat emptor
-							 */
-							if(nfound < (CMDDATALEN-4)-5)
-							{
-								/* order is important */
-								found[nfound++] = tck->id;
-								found[nfound++] = tms->id;
-								found[nfound++] = tdi->id;
-								found[nfound++] = tdo->id;
-								found[nfound++] = nrst->id;
-							}
-                                                }
-
-						tdi = tdi->next;
-                                        }
-
-                                        tdo = tdo->next;
-                                }
-
-                                tms = tms->next;
-                        }
-
-                        tck = tck->next;
-                }
-
-                nrst = nrst->next;
-        }
+	do
+	{
+		itck = 0;
+		for(tck = pins; tck; tck = tck->next)
+		{
+			itck++;
+			if(tck == nrst)
+				continue;
+
+			for(tms = pins; tms; tms = tms->next)
+			{
+				if(tms == nrst || tms == tck)
+					continue;
+
+				idscan(tck, tms, nrst);
+
+				for(tdo = pins; tdo; tdo = tdo->next)
+				{
+					if(tdo == nrst || tdo == tck || tdo == tms || !isidcode(tdo->word))
+						continue;
 
+					hit(a, tck, tms, tdiscan(tck, tms, tdo, nrst), tdo, nrst, tdo->word);
+				}
+			}
+
+			/* progress: nrst, tck done, of how many */
+			cmddata[0] = nrst ? nrst->id : NOPIN;
+			cmddata[1] = itck;
+			cmddata[2] = npins();
+			txdata(a, JSCAN_CMD_PROGRESS, 3);
+		}
+
+		nrst = nrst ? nrst->next : pins;
+	}
+	while(nrst && !nfound);
+
+	cmddata[0] = nfound / 5;
+	txdata(a, JSCAN_CMD_DONE, 1);
 }
 
+/* clock n TMS bits, LSB first */
 static void
-tapstate(char * s, Pin * tck, Pin * tms)
+tapstate(uint16_t s, uint8_t n, Pin * tck, Pin * tms)
 {
-        int x;
-
-        while(*s)
-        {
-                x = *s - '0';
-                /* issue */
-                if(x)   
-                        *tms->port |= (1 << tms->bit);
-                else
-                        *tms->port &= ~(1 << tms->bit);
-
-                /* strobe */
-                *tck->port &= ~(1 << tck->bit);
-                _delay_ms(xdelay);
-                *tck->port |= (1 << tck->bit);
-
-                s++;
-        }
+	while(n--)
+	{
+		/* issue */
+		if(s & 1)
+			*tms->port |= (1 << tms->bit);
+		else
+			*tms->port &= ~(1 << tms->bit);
+		s >>= 1;
+
+		/* strobe */
+		jtick();
+		clockstrobe(tck);
+	}
+
+	/* stay put while TDI moves */
+	*tms->port &= ~(1 << tms->bit);
 }
 
 static void
@@ -1,3 +1,38 @@
+/*! \file adiv5.c
+  \brief ARM Debug Interface v5 (Cortex) over JTAG-DP
+*/
+
+#include "platform.h"
+#include "command.h"
+#include "jtag.h"
+#include "adiv5.h"
+
+//! Handles ADIv5 JTAG-DP commands.  Forwards others to JTAG.
+void adiv5_handle_fn( uint8_t const app,
+                      uint8_t const verb,
+                      uint32_t const len);
+
+// define the adiv5 app's app_t
+app_t const adiv5_app = {
+
+	/* app number */
+	JTAGADIV5,
+
+	/* handle fn */
+	adiv5_handle_fn,
+
+	/* name */
+	"JTAGADIV5",
+
+	/* desc */
+	"\tThe JTAGADIV5 app extends the basic JTAG app with DP/AP\n"
+	"\taccess and MEM-AP block transfers for ARM Cortex devices.\n"
+};
+
+unsigned char adiv5_last_ir = -1;
+unsigned long adiv5_last_select = -1;
+unsigned char adiv5_ack = 0;
+
 // ARM Debug Interface version 5 (cortex and above)
 // from the ARM Debug Interface v5 Architecture Specification (IHI 0031A) document:
 // "Logically, the ARM Debug Interface (ADI) consists of:
@@ -25,7 +60,8 @@
 
 
 //// JTAG debug protocol
-//  as with arm7tdmi will soon be, we're going to live at Select DR state as home state.  this allows each transaction to finish to a known state.  it's more for mental peace more than anything, since the old way works... but the mental understanding that the tap may either be in exit2 or runtest/idle is a hack at best.
+//  every scan goes back through Run-Test/Idle, as jtag.c does, which also gives the AP a few TCKs to finish the access before the next one.
+//  DPACC/APACC are 35-bit scans; the data shifted out is the result of the *previous* access, which is what lets MEM-AP reads be pipelined.
 //
 //
 
@@ -41,11 +77,142 @@
 
 
 
+//! Start JTAG, setup pins, reset TAP and forget cached IR/SELECT
+void adiv5_start(void){
+  jtag_setup();
+  jtag_reset_tap();
+  adiv5_last_ir = -1;
+  adiv5_last_select = -1;
+}
+
+//! Shift a new instruction in, only if it differs from the last one.
+void adiv5_shift_ir(unsigned char ir){
+  if (adiv5_last_ir != ir){
+    jtag_capture_ir();
+    jtag_shift_register();
+    jtag_trans_n(ir, 4, LSB);
+    adiv5_last_ir = ir;
+  }
+}
+
+//! One 35-bit DPACC/APACC scan, retried while the DP answers WAIT.  Returns the previous access' result.
+unsigned long adiv5_scan(unsigned char ir, unsigned char addr, unsigned char rnw, unsigned long data){
+  unsigned long retval;
+  unsigned int retries = ADI_WAIT_RETRIES;
+  adiv5_shift_ir(ir);
+  do {
+    jtag_capture_dr();
+    jtag_shift_register();
+    adiv5_ack = jtag_trans_n(((addr>>1) & 6) | rnw, 3, LSB| NOEND);
+    retval = jtag_trans_n(data, 32, LSB);                   // back through Run-Test/Idle, giving the AP time
+  } while (adiv5_ack == ADI_ACK_WAIT && --retries);
+  return retval;
+}
+
+/************************* Debug Port ****************************/
+unsigned long adiv5_dp_read(unsigned char addr){
+  adiv5_scan(ADI_IR_DPACC, addr, 1, 0);
+  return adiv5_scan(ADI_IR_DPACC, ADI_DP_RDBUFF, 1, 0);
+}
+
+void adiv5_dp_write(unsigned char addr, unsigned long val){
+  adiv5_scan(ADI_IR_DPACC, addr, 0, val);
+  if (addr == ADI_DP_SELECT)
+    adiv5_last_select = val;
+}
+
+//! Read CTRL/STAT, clearing any sticky error flags it reports.
+unsigned long adiv5_status(void){
+  unsigned long stat = adiv5_dp_read(ADI_DP_CTRLSTAT);
+  if (stat & (ADI_CTRLSTAT_STICKYERR | ADI_CTRLSTAT_STICKYCMP | ADI_CTRLSTAT_STICKYORUN))
+    adiv5_dp_write(ADI_DP_CTRLSTAT, stat);                  // sticky bits are write-one-to-clear on JTAG-DP
+  return stat;
+}
+
+/************************* Access Ports ****************************/
+//! Point SELECT at the AP and register bank, unless it already is.
+void adiv5_ap_select(unsigned char ap, unsigned char addr){
+  unsigned long select = ((unsigned long)ap<<24) | (addr & 0xf0);
+  if (adiv5_last_select != select)
+    adiv5_dp_write(ADI_DP_SELECT, select);
+}
+
+unsigned long adiv5_ap_read(unsigned char ap, unsigned char addr){
+  adiv5_ap_select(ap, addr);
+  adiv5_scan(ADI_IR_APACC, addr, 1, 0);                     // posted, result lands in RDBUFF
+  return adiv5_scan(ADI_IR_DPACC, ADI_DP_RDBUFF, 1, 0);
+}
+
+void adiv5_ap_write(unsigned char ap, unsigned char addr, unsigned long val){
+  adiv5_ap_select(ap, addr);
+  adiv5_scan(ADI_IR_APACC, addr, 0, val);
+}
+
+/************************* MEM-AP Block Transfers ****************************/
+//! Set CSW for 32-bit accesses with single auto-increment, keeping the implementation-defined bits.
+void adiv5_mem_setup(unsigned char ap){
+  unsigned long csw = adiv5_ap_read(ap, ADI_MEMAP_CSW);
+  csw = (csw & ~ADI_CSW_MODE_MASK) | ADI_CSW_SIZE_32 | ADI_CSW_ADDRINC_SINGLE;
+  adiv5_ap_write(ap, ADI_MEMAP_CSW, csw);
+}
+
+//! Words left before TAR auto-increment wraps.
+unsigned int adiv5_mem_chunk(unsigned long adr, unsigned int count){
+  unsigned int chunk = (ADI_TAR_WRAP - (adr & (ADI_TAR_WRAP-1))) >> 2;
+  return (chunk > count) ? count : chunk;
+}
+
+//! Stream a block of words as a single reply, followed by CTRL/STAT.
+//  DRW reads are pipelined: each APACC scan returns the word read by the one before it.
+void adiv5_mem_read_block(uint8_t app, uint8_t verb, unsigned char ap,
+                          unsigned long adr, unsigned int count){
+  unsigned int chunk;
+
+  adr &= ~3L;
+  if (count > ADI_READ_BLOCK_MAX)
+    count = ADI_READ_BLOCK_MAX;
+  txhead(app, verb, (count<<2) + 4);
+  if (count)
+    adiv5_mem_setup(ap);
+  while (count > 0){
+    chunk = adiv5_mem_chunk(adr, count);
+    adiv5_ap_write(ap, ADI_MEMAP_TAR, adr);                 // once per 1KiB block
+    count -= chunk;
+    adr += (unsigned long)chunk<<2;
+
+    adiv5_scan(ADI_IR_APACC, ADI_MEMAP_DRW, 1, 0);          // prime the pipeline
+    while (--chunk)
+      txlong(adiv5_scan(ADI_IR_APACC, ADI_MEMAP_DRW, 1, 0));
+    txlong(adiv5_scan(ADI_IR_DPACC, ADI_DP_RDBUFF, 1, 0));  // drain the last one
+  }
+  txlong(adiv5_status());
+}
+
+//! Write a block of words.  Returns CTRL/STAT, so the caller can check STICKYERR.
+unsigned long adiv5_mem_write_block(unsigned char ap, unsigned long adr,
+                                    const unsigned long *data, unsigned int count){
+  unsigned int chunk;
+
+  adr &= ~3L;
+  if (count)
+    adiv5_mem_setup(ap);
+  while (count > 0){
+    chunk = adiv5_mem_chunk(adr, count);
+    adiv5_ap_write(ap, ADI_MEMAP_TAR, adr);
+    count -= chunk;
+    adr += (unsigned long)chunk<<2;
+    while (chunk--)
+      adiv5_scan(ADI_IR_APACC, ADI_MEMAP_DRW, 0, *data++);
+  }
+  return adiv5_status();
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-//! Handles ARM7TDMI JTAG commands.  Forwards others to JTAG.
-void adiv5handle(unsigned char app, unsigned char verb, unsigned long len){
-  unsigned int val;
- 
+//! Handles ADIv5 JTAG-DP commands.  Forwards others to JTAG.
+void adiv5_handle_fn( uint8_t const app,
+                      uint8_t const verb,
+                      uint32_t const len)
+{
   switch(verb){
   case START:
     //Enter JTAG mode.
@@ -53,56 +220,46 @@ void adiv5handle(unsigned char app, unsigned char verb, unsigned long len){
     txdata(app,verb,0);
     break;
   case JTAG_IR_SHIFT:
-    cmddataword[0] = jtagarm_shift_ir(cmddata[0], cmddata[1]);
+    adiv5_shift_ir(cmddata[0]);
     txdata(app,verb,1);
     break;
   case JTAG_DR_SHIFT:
-    jtag_goto_shift_dr();
-    if (cmddata[0]>32){
-        val = cmddatalong[1];
-        cmddatalong[0] = jtagtransn(cmddatalong[1],cmddata[0]-32,cmddata[1]|NOEND);
-        cmddatalong[1] = jtagtransn(cmddatalong[2],32,cmddata[1]);
-        txdata(app,verb,5);
-    } else {
-        cmddatalong[0] = jtagtransn(cmddatalong[1],cmddata[0],cmddata[1]);
-        txdata(app,verb,5);
-    }
-    tapstate = (cmddata[1]&NORETIDLE)>0?Update_DR:RunTest_Idle;
-    break;
-  case JTAGADI_DEBUG_INSTR:
-    cmddatalong[0] = adiv5_instr_primitive(cmddatalong[0],cmddata[4]);
+    // [bits, flags, 0, 0, data32], 32 bits at most
+    jtag_capture_dr();
+    jtag_shift_register();
+    cmddatalong[0] = jtag_trans_n(cmddatalong[1], cmddata[0], cmddata[1]);
     txdata(app,verb,4);
     break;
-  case JTAGADI_GET_REGISTER:
-    val = cmddata[0];
-    cmddatalong[0] = adiv5_get_register(val);
+  case JTAGADIV5_DP_READ:
+    cmddatalong[0] = adiv5_dp_read(cmddata[0]);
     txdata(app,verb,4);
     break;
-  case JTAGADI_SET_REGISTER:
-    adiv5_set_register(cmddatalong[1], cmddatalong[0]);
+  case JTAGADIV5_DP_WRITE:
+    // [addr, 0, 0, 0, val32]
+    adiv5_dp_write(cmddata[0], cmddatalong[1]);
+    txdata(app,verb,0);
+    break;
+  case JTAGADIV5_AP_READ:
+    // [ap, addr]
+    cmddatalong[0] = adiv5_ap_read(cmddata[0], cmddata[1]);
     txdata(app,verb,4);
     break;
-  case JTAG_RESETTARGET:
-    debugstr("RESET TARGET");
-    CLRTST;
-    delay(cmddataword[0]);
-    SETTST;
+  case JTAGADIV5_AP_WRITE:
+    // [ap, addr, 0, 0, val32]
+    adiv5_ap_write(cmddata[0], cmddata[1], cmddatalong[1]);
+    txdata(app,verb,0);
+    break;
+  case JTAGADIV5_MEM_READ_BLOCK:
+    // [ap, 0, 0, 0, adr32, count16], reply is count words, at most ADI_READ_BLOCK_MAX, then CTRL/STAT
+    adiv5_mem_read_block(app, verb, cmddata[0], cmddatalong[1], cmddataword[4]);
+    break;
+  case JTAGADIV5_MEM_WRITE_BLOCK:
+    // [ap, 0, 0, 0, adr32, words...], reply is CTRL/STAT
+    cmddatalong[0] = adiv5_mem_write_block(cmddata[0], cmddatalong[1],
+                                           &cmddatalong[2], (len > 8) ? (len-8)>>2 : 0);
     txdata(app,verb,4);
     break;
-
-
-  //case JTAGARM7_STEP_INSTR:
-/*  case JTAGARM7_READ_CODE_MEMORY:
-  case JTAGARM7_WRITE_FLASH_PAGE:
-  case JTAGARM7_READ_FLASH_PAGE:
-  case JTAGARM7_MASS_ERASE_FLASH:
-  case JTAGARM7_PROGRAM_FLASH:
-  case JTAGARM7_LOCKCHIP:
-  case JTAGARM7_CHIP_ERASE:
-  */
   default:
-    jtaghandle(app,verb,len);
+    (*(jtag_app.handle))(app,verb,len);
   }
 }
-
-
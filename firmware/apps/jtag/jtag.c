@@ -41,6 +41,24 @@ app_t const jtag_app = {
 //! Remembers what the current JTAG state is
 enum eTAPState jtag_state = UNKNOWN;
 
+//! Cached scan chain model, device 0 nearest TDO.  Empty until scanned.
+uint8_t jtag_chain_len = 0;
+//! Device that IR/DR shifts are aimed at; the others are padded in BYPASS
+uint8_t jtag_chain_target = 0;
+uint8_t jtag_chain_irlen[JTAG_CHAIN_MAX];
+uint32_t jtag_chain_idcode[JTAG_CHAIN_MAX];
+//! Set once a NOEND shift has put in its leading padding
+uint8_t jtag_chain_midscan = 0;
+//! Set by Test-Logic-Reset, when the other TAPs hold IDCODE rather than 
+//	BYPASS in their DRs; cleared by the next IR update
+uint8_t jtag_chain_idcodes = 1;
+
+//! Extra delay() count in each TCK half period
+uint16_t jtag_tck_delay = 0;
+//! Reference reads from the last auto-tune
+uint32_t jtag_tune_id = 0;
+uint8_t jtag_tune_offset = 0xFF;
+
 //! Returns true if we're in any of the data register states
 int in_dr()
 {
@@ -84,8 +102,10 @@ void jtag_tcktock()
 {
 	CLRTCK; 
 	led_toggle();
+	TCKWAIT;
 	SETTCK; 
 	led_toggle();
+	TCKWAIT;
 }
 
 //! Goes through test-logic-reset and ends in run-test-idle
@@ -101,6 +121,8 @@ void jtag_reset_tap()
 	CLRTMS;
 	jtag_tcktock();  // now in Run-Test/Idle state
 	jtag_state = RUN_TEST_IDLE;
+	jtag_chain_midscan = 0;
+	jtag_chain_idcodes = 1;
 }
 
 //! Set up the pins for JTAG mode.
@@ -160,6 +182,7 @@ void jtag_capture_ir()
 	jtag_tcktock(); // Capture-IR
 
 	jtag_state = CAPTURE_IR;
+	jtag_chain_midscan = 0;
 }
 
 //! Get into Capture-DR state
@@ -179,12 +202,14 @@ void jtag_capture_dr()
 	jtag_tcktock(); // Capture-IR
 
 	jtag_state = CAPTURE_DR;
+	jtag_chain_midscan = 0;
 }
 
 //! Gets back to run-test-idle without going through the test-logic-reset
 void jtag_run_test_idle()
 {
 	CLRMOSI;
+	jtag_chain_midscan = 0;
 
 	if (in_state(SELECT_DR_SCAN | SELECT_IR_SCAN))
 	{
@@ -236,6 +261,44 @@ void jtag_run_test_idle()
 	}
 }
 
+//! Count the padding bits on either side of the target, for the register being shifted
+//	Until an IR update has loaded BYPASS, a TAP with an IDCODE still has 
+//	its 32-bit IDCODE register selected.
+void jtag_chain_padding(uint16_t *pre, uint16_t *post)
+{
+	uint8_t i;
+	uint16_t bits;
+
+	*pre = *post = 0;
+	for (i = 0; i < jtag_chain_len; i++)
+	{
+		if (in_ir())
+			bits = jtag_chain_irlen[i];
+		else if (jtag_chain_idcodes && jtag_chain_idcode[i])
+			bits = 32;
+		else
+			bits = 1;
+		if (i < jtag_chain_target)
+			*pre += bits;
+		else if (i > jtag_chain_target)
+			*post += bits;
+	}
+}
+
+//! Shift ones, which is BYPASS in every IR, raising TMS on the last bit if asked
+void jtag_shift_ones(uint16_t count, uint8_t exit)
+{
+	SETMOSI;
+	while (count--)
+	{
+		if (!count && exit)
+			SETTMS; //TMS high on last bit to exit.
+		jtag_tcktock();
+	}
+	if (exit)
+		jtag_state <<= 1; // Exit1-DR or Exit1-IR
+}
+
 int savedtclk;
 //	NOTE: important: THIS MODULE REVOLVES AROUND RETURNING TO RUNTEST/IDLE, OR 
 //	THE FUNCTIONAL EQUIVALENT
@@ -252,13 +315,18 @@ int savedtclk;
 //		NORETIDLE is used for special cases where (as with arm) the debug 
 //		subsystem does not want to return to the RUN-TEST/IDLE state between 
 //		setting IR and DR
+//
+//		once the chain has been scanned, the shift is aimed at 
+//		jtag_chain_target, and the other TAPs are padded with BYPASS ones
+//		in the same scan
 uint32_t jtag_trans_n(uint32_t word, 
 		      uint8_t bitcount, 
 		      enum eTransFlags flags) 
 {
-	uint8_t bit;
+	uint8_t bit, last;
 	uint32_t high = (1L << (bitcount - 1));
 	uint32_t mask = high - 1;
+	uint16_t pre, post;
 
 	if (!in_state(SHIFT_IR | SHIFT_DR))
 	{
@@ -268,6 +336,14 @@ uint32_t jtag_trans_n(uint32_t word,
 
 	SAVETCLK;
 
+	jtag_chain_padding(&pre, &post);
+	if (!jtag_chain_midscan)
+		jtag_shift_ones(pre, 0);
+	jtag_chain_midscan = 1;
+
+	// TMS goes high on our last bit, unless padding follows
+	last = !(flags & NOEND) && !post;
+
 	if (flags & LSB) 
 	{
 		for (bit = bitcount; bit > 0; bit--) 
@@ -283,12 +359,12 @@ uint32_t jtag_trans_n(uint32_t word,
 			}
 			word >>= 1;
 
-			if ((bit == 1) && !(flags & NOEND))
+			if ((bit == 1) && last)
 				SETTMS; //TMS high on last bit to exit.
 
 			jtag_tcktock();
 
-			if ((bit == 1) && !(flags & NOEND))
+			if ((bit == 1) && last)
 				jtag_state <<= 1; // Exit1-DR or Exit1-IR
 
 			/* read MISO on trailing edge */
@@ -313,12 +389,12 @@ uint32_t jtag_trans_n(uint32_t word,
 			}
 			word = (word & mask) << 1;
 
-			if ((bit==1) && !(flags & NOEND))
+			if ((bit==1) && last)
 				SETTMS; //TMS high on last bit to exit.
 
 			jtag_tcktock();
 
-			if ((bit == 1) && !(flags & NOEND))
+			if ((bit == 1) && last)
 				jtag_state <<= 1; // Exit1-DR or Exit1-IR
 
 			/* read MISO on trailing edge */
@@ -332,13 +408,22 @@ uint32_t jtag_trans_n(uint32_t word,
 	  word = ((word << 16) | (word >> 4)) & 0x000FFFFF;
 	}
 	
+	if (!(flags & NOEND) && post)
+		jtag_shift_ones(post, 1);
+
 	RESTORETCLK;
 
 	if (!(flags & NOEND))
 	{
+		jtag_chain_midscan = 0;
+
 		// exit state
 		jtag_tcktock();
 
+		// the padding ones are BYPASS from here on
+		if (in_ir())
+			jtag_chain_idcodes = 0;
+
 		jtag_state <<= 3; // Update-DR or Update-IR
 
 		// update state
@@ -468,6 +553,10 @@ uint32_t jtag_get_device_id(int chip)
 	uint16_t chain_length;
 	uint32_t id = 0;
 
+	// the cached chain already knows, and knows which TAPs have no IDCODE
+	if (chip < jtag_chain_len)
+		return jtag_chain_idcode[chip];
+
 	// reset everything
 	jtag_reset_tap();
 
@@ -489,9 +578,10 @@ uint32_t jtag_get_device_id(int chip)
 	jtag_capture_dr();
 	jtag_shift_register();
 
-	// read out the 32-bit ID codes for each device
+	// read out the 32-bit ID codes for each device, across the whole chain
 	CLRTMS;
 	CLRMOSI;
+	jtag_chain_midscan = 1;
 	for (i = 0; i < (chip + 1); i++)
 	{
 		id = jtag_trans_n(0xFFFFFFFF, 32, LSB | NOEND | NORETIDLE);
@@ -502,6 +592,295 @@ uint32_t jtag_get_device_id(int chip)
 	return id;
 }
 
+//! Scans the chain, caching each TAP's IDCODE and IR length
+//	After Test-Logic-Reset every DR holds either a 32-bit IDCODE, whose 
+//	LSB is 1, or a 1-bit BYPASS holding 0, so the IDCODEs can be walked 
+//	from the TDO end until our own ones come back out.  IR lengths are 
+//	split from the Capture-IR pattern, which starts with 01 for every 
+//	TAP; captures with other ones in them can fool this, in which case 
+//	the host sets the lengths with JTAG_CHAIN_SET_IRLEN.
+uint8_t jtag_chain_scan()
+{
+	uint16_t i, total, start;
+	uint8_t n = 0, dev = 0, bit, prev = 1;
+	uint32_t id;
+
+	// nothing is padded while we look
+	jtag_chain_len = 0;
+	jtag_chain_target = 0;
+
+	jtag_reset_tap();
+	jtag_capture_dr();
+	jtag_shift_register();
+	SETMOSI;
+	while (n < JTAG_CHAIN_MAX)
+	{
+		jtag_tcktock();
+		if (!READMISO)
+		{
+			jtag_chain_idcode[n++] = 0; // BYPASS, no IDCODE
+			continue;
+		}
+		// 31 ones in, so none of them land in the bits read back
+		id = 1 | (jtag_trans_n(0x7FFFFFFF, 31, LSB | NOEND) << 1);
+		if (id == 0xFFFFFFFF)
+			break;
+		jtag_chain_idcode[n++] = id;
+	}
+	jtag_run_test_idle();
+
+	// the first IDCODE must match a plain 32-bit read of it
+	if (n && jtag_chain_idcode[0])
+	{
+		jtag_reset_tap();
+		jtag_capture_dr();
+		jtag_shift_register();
+		id = jtag_trans_n(0xFFFFFFFF, 32, LSB | NOEND | NORETIDLE);
+		jtag_run_test_idle();
+		if (id != jtag_chain_idcode[0])
+		{
+			debugstr("chain scan IDCODE mismatch");
+			return 0;
+		}
+	}
+
+	total = jtag_detect_ir_width();
+	if (!n || !total || total >= 1024)
+		return 0;
+
+	// read the Capture-IR pattern, leaving every TAP in BYPASS
+	jtag_capture_ir();
+	jtag_shift_register();
+	SETMOSI;
+	start = 0;
+	for (i = 0; i < total; i++)
+	{
+		if (i == total - 1)
+			SETTMS; // exit on last bit
+		jtag_tcktock();
+		bit = READMISO;
+		// a 1 after a 0, past this TAP's own 01, starts the next TAP
+		if (bit && !prev && i >= start + 2 && dev + 1 < n)
+		{
+			jtag_chain_irlen[dev++] = i - start;
+			start = i;
+		}
+		prev = bit;
+	}
+	jtag_chain_irlen[dev++] = total - start;
+	while (dev < n)
+		jtag_chain_irlen[dev++] = 0;
+	jtag_state = EXIT1_IR;
+	jtag_run_test_idle();
+	jtag_chain_idcodes = 0;
+
+	jtag_chain_len = n;
+	return n;
+}
+
+//! Reads the first IDCODE out of Test-Logic-Reset, and how many BYPASS 
+//	bits the tuning pattern takes to come through the chain (0xFF if it 
+//	never does)
+uint32_t jtag_tune_sample(uint8_t *offset)
+{
+	uint16_t i;
+	uint32_t id = 0, window = 0;
+
+	jtag_reset_tap();
+	jtag_capture_dr();
+	jtag_shift_register();
+	SETMOSI;
+	for (i = 0; i < 32; i++)
+	{
+		jtag_tcktock();
+		id = (id >> 1) | ((uint32_t)READMISO << 31);
+	}
+	jtag_run_test_idle();
+
+	// every IR to BYPASS
+	jtag_capture_ir();
+	jtag_shift_register();
+	SETMOSI;
+	for (i = 0; i < 1024; i++)
+	{
+		if (i == 1023)
+			SETTMS; // exit on last bit
+		jtag_tcktock();
+	}
+	jtag_state = EXIT1_IR;
+	jtag_run_test_idle();
+
+	// flush the BYPASS bits with zeros, then watch for the pattern
+	jtag_capture_dr();
+	jtag_shift_register();
+	CLRMOSI;
+	for (i = 0; i < 64; i++)
+		jtag_tcktock();
+	*offset = 0xFF;
+	for (i = 0; i < 32 + 64; i++)
+	{
+		if (i < 32 && (JTAG_TUNE_PATTERN >> i) & 1)
+			SETMOSI;
+		else
+			CLRMOSI;
+		jtag_tcktock();
+		window = (window >> 1) | ((uint32_t)READMISO << 31);
+		if (i >= 31 && window == JTAG_TUNE_PATTERN)
+		{
+			*offset = i - 31;
+			break;
+		}
+	}
+	jtag_run_test_idle();
+
+	return id;
+}
+
+//! Do repeated reads at this delay all match the reference?
+uint8_t jtag_tune_stable(uint16_t tckdelay, uint8_t iterations)
+{
+	uint8_t offset;
+
+	jtag_tck_delay = tckdelay;
+	while (iterations--)
+	{
+		if (jtag_tune_sample(&offset) != jtag_tune_id || offset != jtag_tune_offset)
+			return 0;
+	}
+	return 1;
+}
+
+//! Binary-search the shortest TCK delay that reads back stable IDCODE and 
+//	BYPASS patterns, taking the reference from the slowest delay.  Leaves 
+//	the result in jtag_tck_delay, or returns 0xFFFF with the old delay 
+//	kept if even the slowest is not stable.
+uint16_t jtag_autotune(uint8_t iterations, uint16_t slowest)
+{
+	uint16_t lo = 0, hi = slowest, mid, old = jtag_tck_delay;
+
+	jtag_tck_delay = slowest;
+	jtag_tune_id = jtag_tune_sample(&jtag_tune_offset);
+	if (jtag_tune_offset == 0xFF || !jtag_tune_stable(slowest, iterations))
+	{
+		jtag_tck_delay = old;
+		return 0xFFFF;
+	}
+
+	while (lo < hi)
+	{
+		mid = (lo + hi) >> 1;
+		if (jtag_tune_stable(mid, iterations))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	jtag_tck_delay = hi;
+	return hi;
+}
+
+//! Last boundary register sample, for the delta encoding
+uint8_t jtag_bscan_prev[(JTAG_BSCAN_MAXBITS + 7) / 8];
+
+//! Repeatedly capture the boundary register, streaming the changes
+//	cmddata is [irlen, instruction32, bits16, count16], big endian.  The 
+//	instruction, normally SAMPLE/PRELOAD, is loaded once, and the DR is 
+//	then captured count times back to back.  Each capture shifts the 
+//	previous sample back in, so with EXTEST the pins keep what they held.
+//
+//	Byte i of a sample holds cells 8i to 8i+7, cell 0 nearest TDO as in 
+//	BSDL.  Each sample is sent as a count of changed bytes and then an 
+//	(index, xor) pair for each, against the previous sample; the first 
+//	is against zeros.  Samples are packed into JTAG_BSCAN_CAPTURE 
+//	packets, and an OK packet with the number of samples ends the run.
+void jtag_bscan_capture(uint8_t app, uint8_t verb, uint32_t len)
+{
+	uint8_t irlen = cmddata[0], cur, x, *rec;
+	uint32_t ir;
+	uint16_t bits, count, nbytes, i, s, used = 0;
+
+	ir = ((uint32_t)cmddata[1] << 24) | ((uint32_t)cmddata[2] << 16) |
+		((uint16_t)cmddata[3] << 8) | cmddata[4];
+	bits = (cmddata[5] << 8) | cmddata[6];
+	count = (cmddata[7] << 8) | cmddata[8];
+	nbytes = (bits + 7) >> 3;
+
+	if (len < 9 || !irlen || irlen > 32 || !bits || bits > JTAG_BSCAN_MAXBITS)
+	{
+		txdata(app,NOK,0);
+		return;
+	}
+
+	if (!in_state(RUN_TEST_IDLE | UPDATE_DR | UPDATE_IR))
+		jtag_reset_tap();
+	jtag_capture_ir();
+	jtag_shift_register();
+	jtag_trans_n(ir, irlen, LSB);
+
+	for (i = 0; i < nbytes; i++)
+		jtag_bscan_prev[i] = 0;
+
+	for (s = 0; s < count; s++)
+	{
+		if (used + 1 + 2 * nbytes > CMDDATALEN)
+		{
+			txdata(app,verb,used);
+			used = 0;
+		}
+		rec = cmddata + used++;
+		*rec = 0;
+
+		jtag_capture_dr();
+		jtag_shift_register();
+		for (i = 0; i < nbytes; i++)
+		{
+			if (i == nbytes - 1)
+				cur = jtag_trans_n(jtag_bscan_prev[i], bits - (i << 3), LSB);
+			else
+				cur = jtag_trans_n(jtag_bscan_prev[i], 8, LSB | NOEND);
+			x = cur ^ jtag_bscan_prev[i];
+			if (x)
+			{
+				cmddata[used++] = i;
+				cmddata[used++] = x;
+				(*rec)++;
+				jtag_bscan_prev[i] = cur;
+			}
+		}
+	}
+	if (used)
+		txdata(app,verb,used);
+	cmddataword[0] = htons(count);
+	txdata(app,OK,2);
+}
+
+//! Aim later IR/DR shifts at one TAP of the cached chain
+int jtag_chain_select(uint8_t dev)
+{
+	if (dev >= jtag_chain_len)
+		return -1;
+	jtag_chain_target = dev;
+	return 0;
+}
+
+//! Reply with the chain model: count, target, then IR length and IDCODE per TAP
+void jtag_chain_report(uint8_t app, uint8_t verb)
+{
+	uint8_t i;
+	uint8_t *p = cmddata + 2;
+
+	cmddata[0] = jtag_chain_len;
+	cmddata[1] = jtag_chain_target;
+	for (i = 0; i < jtag_chain_len; i++)
+	{
+		*p++ = jtag_chain_irlen[i];
+		*p++ = jtag_chain_idcode[i] >> 24;
+		*p++ = jtag_chain_idcode[i] >> 16;
+		*p++ = jtag_chain_idcode[i] >> 8;
+		*p++ = jtag_chain_idcode[i];
+	}
+	txdata(app, verb, p - cmddata);
+}
+
 //! Shift 8 bits in/out of selected register
 uint8_t jtag_trans_8(uint8_t in)
 {
@@ -548,6 +927,7 @@ uint8_t jtag_ir_shift_8(uint8_t in)
   jtag_tcktock();
   //jtag_state = CAPTURE_IR;
   jtag_state = SHIFT_IR;
+  jtag_chain_midscan = 0;
   // shift IR bits
   return jtag_trans_8(in);
 }
@@ -575,6 +955,8 @@ void jtag_handle_fn(uint8_t const app,
 					uint8_t const verb,
 					uint32_t const len)
 {
+	uint8_t i;
+
 	switch(verb)
 	{
 	// START handled by specific JTAG
@@ -616,8 +998,15 @@ void jtag_handle_fn(uint8_t const app,
 		break;
 
 	case JTAG_DETECT_CHAIN_LENGTH:
-		jtag_reset_tap();
-		cmddataword[0] = htons(jtag_detect_chain_length());
+		if (jtag_chain_len)
+		{
+			cmddataword[0] = htons(jtag_chain_len);
+		}
+		else
+		{
+			jtag_reset_tap();
+			cmddataword[0] = htons(jtag_detect_chain_length());
+		}
 		txdata(app,verb,2);
 		break;
 
@@ -627,6 +1016,63 @@ void jtag_handle_fn(uint8_t const app,
 		txdata(app,verb,4);
 		break;
 
+	case JTAG_CHAIN_SCAN:
+		jtag_chain_scan();
+		jtag_chain_report(app,verb);
+		break;
+
+	case JTAG_CHAIN_SELECT:
+		if (len < 1 || jtag_chain_select(cmddata[0]))
+		{
+			txdata(app,NOK,0);
+			break;
+		}
+		jtag_chain_report(app,verb);
+		break;
+
+	case JTAG_SET_TCK_DELAY:
+		if (len >= 2)
+			jtag_tck_delay = ntohs(cmddataword[0]);
+		cmddataword[0] = htons(jtag_tck_delay);
+		txdata(app,verb,2);
+		break;
+
+	case JTAG_AUTOTUNE:
+		// [iterations, slowest delay]; reply is the delay, reference IDCODE and BYPASS count
+		cmddataword[0] = htons(jtag_autotune(len >= 1 ? cmddata[0] : JTAG_TUNE_ITERATIONS,
+		                                     len >= 3 ? (cmddata[1] << 8) | cmddata[2]
+		                                              : JTAG_TUNE_SLOWEST));
+		cmddata[2] = jtag_tune_id >> 24;
+		cmddata[3] = jtag_tune_id >> 16;
+		cmddata[4] = jtag_tune_id >> 8;
+		cmddata[5] = jtag_tune_id;
+		cmddata[6] = jtag_tune_offset;
+		txdata(app,verb,7);
+		break;
+
+	case JTAG_BSCAN_CAPTURE:
+		jtag_bscan_capture(app,verb,len);
+		break;
+
+	case JTAG_CHAIN_SET_IRLEN:
+		// one IR length per TAP, from the TDO end; for chains the scan can't split
+		if (len < 1 || len > JTAG_CHAIN_MAX)
+		{
+			txdata(app,NOK,0);
+			break;
+		}
+		for (i = 0; i < len; i++)
+		{
+			if (i >= jtag_chain_len)
+				jtag_chain_idcode[i] = 0;
+			jtag_chain_irlen[i] = cmddata[i];
+		}
+		jtag_chain_len = len;
+		if (jtag_chain_target >= len)
+			jtag_chain_target = 0;
+		jtag_chain_report(app,verb);
+		break;
+
 	default:
 		txdata(app,NOK,0);
 	}
@@ -392,6 +392,65 @@ void jtag430_setinstrfetch(){
 
 
 
+/* Statistical profiling.  The CPU runs freely between samples.  Each
+   sample takes the bus, clocks TCLK until the CPU fetches an
+   instruction, reads the fetch address from the address bus, and
+   then halts with the same JMP $ trick as jtag430_haltcpu(), so the
+   CPU picks up at that instruction when it is released.
+*/
+
+//! Take a running CPU and read the address of its next instruction.
+unsigned long jtag430_samplepc(){
+  unsigned int i;
+  unsigned long pc=0xFFFFFFFF;
+  
+  jtag_ir_shift_8(IR_CNTRL_SIG_16BIT);
+  jtag_dr_shift_16(0x2401);//JTAG controls the bus
+  jtag_ir_shift_8(IR_CNTRL_SIG_CAPTURE);
+  
+  //A sleeping CPU never fetches, so don't wait forever.
+  for(i=0;i<8;i++){
+    if(jtag_dr_shift_16(0x0000) & 0x0080){
+      jtag_ir_shift_8(IR_ADDR_CAPTURE);
+      pc=jtag430_shift_addr(0) & 0xFFFFF;
+      break;
+    }
+    CLRTCLK;
+    SETTCLK;
+  }
+  
+  jtag430_haltcpu();
+  return pc;
+}
+
+//! Fill a histogram of PC samples, from a halted CPU to a halted CPU.
+static void jtag430_profile(unsigned long base,
+			    unsigned int shift,
+			    unsigned int buckets,
+			    unsigned int samples,
+			    unsigned int ms){
+  unsigned long pc;
+  unsigned int i;
+  
+  //[outside, asleep, bucket 0, bucket 1, ...]
+  for(i=0;i<buckets+2;i++)
+    cmddataword[i]=0;
+  
+  while(samples--){
+    jtag430_releasecpu();
+    if(ms)
+      msdelay(ms);
+    pc=jtag430_samplepc();
+    
+    if(pc==0xFFFFFFFF)
+      cmddataword[1]++;
+    else if(pc<base || ((pc-base)>>shift)>=buckets)
+      cmddataword[0]++;
+    else
+      cmddataword[2+((pc-base)>>shift)]++;
+  }
+}
+
 //! Handles classic MSP430 JTAG commands.  Forwards others to JTAG.
 void jtag430_handle_fn(uint8_t const app,
 		       uint8_t const verb,
@@ -533,6 +592,15 @@ void jtag430_handle_fn(uint8_t const app,
     cmddataword[0]=0xDEAD;
     txdata(app,verb,2);
     break;
+  case JTAG430_PROFILE:
+    //32-bit base, bucket shift, bucket count, samples, ms between.
+    at=cmddatalong[0];
+    i=cmddataword[3];
+    if(i>JTAG430_PROFILE_BUCKETS)
+      i=JTAG430_PROFILE_BUCKETS;
+    jtag430_profile(at,cmddata[4],i,cmddataword[4],cmddataword[5]);
+    txdata(app,verb,(i+2)<<1);
+    break;
   case JTAG430_COREIP_ID:
     //cmddataword[0]=jtag430_coreid();
     cmddataword[0]=0xdead;
@@ -59,33 +59,39 @@ unsigned long jtag430_deviceid(){
 }
 
 
+//! Write a word, assuming the CPU is already under JTAG control.
+static void jtag430x2_writeword(unsigned long adr,
+				unsigned int data){
+  CLRTCLK;
+  jtag_ir_shift_8(IR_CNTRL_SIG_16BIT);
+  if(adr>=0x100)
+    jtag_dr_shift_16(0x0500);//word mode
+  else
+    jtag_dr_shift_16(0x0510);//byte mode
+  jtag_ir_shift_8(IR_ADDR_16BIT);
+  jtag430_dr_shift_20(adr);
+  
+  SETTCLK;
+  
+  jtag_ir_shift_8(IR_DATA_TO_ADDR);
+  jtag_dr_shift_16(data);//16 word
+  
+  CLRTCLK;
+  jtag_ir_shift_8(IR_CNTRL_SIG_16BIT);
+  jtag_dr_shift_16(0x0501);
+  SETTCLK;
+  
+  CLRTCLK;
+  SETTCLK;
+  //init state
+}
+
 //! Write data to address
 void jtag430x2_writemem(unsigned long adr,
 			unsigned int data){
   jtag_ir_shift_8(IR_CNTRL_SIG_CAPTURE);
   if(jtag_dr_shift_16(0) & 0x0301){
-    CLRTCLK;
-    jtag_ir_shift_8(IR_CNTRL_SIG_16BIT);
-    if(adr>=0x100)
-      jtag_dr_shift_16(0x0500);//word mode
-    else
-      jtag_dr_shift_16(0x0510);//byte mode
-    jtag_ir_shift_8(IR_ADDR_16BIT);
-    jtag430_dr_shift_20(adr);
-    
-    SETTCLK;
-    
-    jtag_ir_shift_8(IR_DATA_TO_ADDR);
-    jtag_dr_shift_16(data);//16 word
-
-    CLRTCLK;
-    jtag_ir_shift_8(IR_CNTRL_SIG_16BIT);
-    jtag_dr_shift_16(0x0501);
-    SETTCLK;
-
-    CLRTCLK;
-    SETTCLK;
-    //init state
+    jtag430x2_writeword(adr,data);
   }else{
     while(1) led_toggle(); //loop if locked up
   }
@@ -129,6 +135,173 @@ unsigned int jtag430x2_readmem(unsigned long adr){
   //return toret;
 }
 
+/* Block access.  jtag430x2_readmem() polls the control signal and
+   rebuilds the read state for every word, which is most of the time
+   spent dumping a large part.  A burst checks for JTAG control once,
+   then only shifts the 20-bit address and clocks out each word.  The
+   same loop serves MSP430X parts running in MSP430MODE, whose wider
+   drwidth lets jtag430_shift_addr() reach past 64kB.
+*/
+
+//! Take control for a burst of reads, leaving TCLK low.  0 on failure.
+static unsigned int jtag430x2_burst_begin(){
+  unsigned int tries=50;
+  
+  if(jtag430mode==MSP430MODE){
+    jtag430_haltcpu();
+    CLRTCLK;
+    return 1;
+  }
+  
+  jtag_ir_shift_8(IR_CNTRL_SIG_CAPTURE);
+  while(!(jtag_dr_shift_16(0) & 0x0301))
+    if(!--tries)
+      return 0;
+  
+  CLRTCLK;
+  jtag_ir_shift_8(IR_CNTRL_SIG_16BIT);
+  jtag_dr_shift_16(0x0501);//word read
+  return 1;
+}
+
+//! Read one word of a burst.  TCLK is low before and after.
+static unsigned int jtag430x2_burst_read(unsigned long adr){
+  unsigned int val;
+  
+  if(jtag430mode==MSP430MODE){
+    jtag_ir_shift_8(IR_CNTRL_SIG_16BIT);
+    if(adr>0xFF)
+      jtag_dr_shift_16(0x2409);//word read
+    else
+      jtag_dr_shift_16(0x2419);//byte read
+    jtag_ir_shift_8(IR_ADDR_16BIT);
+    jtag430_shift_addr(adr);
+  }else{
+    jtag_ir_shift_8(IR_ADDR_16BIT);
+    jtag430_dr_shift_20(adr);
+  }
+  jtag_ir_shift_8(IR_DATA_TO_ADDR);
+  SETTCLK;
+  CLRTCLK;
+  val=jtag_dr_shift_16(0x0000);
+  
+  if(jtag430mode!=MSP430MODE){
+    //Cycle a bit, as readmem does.
+    SETTCLK;
+    CLRTCLK;
+  }
+  return val;
+}
+
+//! Stream [adr, end) to the host in packets of JTAG430X2_BLOCKSIZE.
+static void jtag430x2_readblock(uint8_t const app,
+				unsigned long adr,
+				unsigned long end){
+  unsigned int l, val;
+  
+  adr&=~1;
+  while(adr<end){
+    l=(end-adr>JTAG430X2_BLOCKSIZE)?JTAG430X2_BLOCKSIZE:(end-adr);
+    l=(l+1)&~1;
+    
+    txhead(app,JTAG430X2_READBLOCK,l);
+    for(;l;l-=2){
+      val=jtag430x2_burst_read(adr);
+      adr+=2;
+      serial_tx(val&0xFF);
+      serial_tx((val&0xFF00)>>8);
+    }
+  }
+}
+
+//! Write a run of words to RAM, checking for JTAG control only once.
+static unsigned int jtag430x2_writeblock(unsigned long adr,
+					 unsigned int *data,
+					 unsigned int words){
+  if(jtag430mode==MSP430MODE){
+    jtag430_haltcpu();
+    while(words--){
+      jtag430_writemem(adr,*data++);
+      adr+=2;
+    }
+    return 1;
+  }
+  
+  jtag_ir_shift_8(IR_CNTRL_SIG_CAPTURE);
+  if(!(jtag_dr_shift_16(0) & 0x0301))
+    return 0;
+  while(words--){
+    jtag430x2_writeword(adr,*data++);
+    adr+=2;
+  }
+  return 1;
+}
+
+//! Set the 20-bit program counter by feeding the CPU MOVA #imm20, PC.
+void jtag430x2_setpc(unsigned long adr){
+  jtag_ir_shift_8(IR_CNTRL_SIG_CAPTURE);
+  if(!(jtag_dr_shift_16(0) & 0x0301))
+    return;
+  
+  CLRTCLK;
+  jtag_ir_shift_8(IR_DATA_16BIT);
+  SETTCLK;
+  jtag_dr_shift_16(0x0080|((adr>>8)&0x0F00));//MOVA #imm20, PC
+  CLRTCLK;
+  jtag_ir_shift_8(IR_CNTRL_SIG_16BIT);
+  jtag_dr_shift_16(0x1400);
+  jtag_ir_shift_8(IR_DATA_16BIT);
+  CLRTCLK;
+  SETTCLK;
+  jtag_dr_shift_16(adr&0xFFFF);//low word of the immediate
+  CLRTCLK;
+  SETTCLK;
+  jtag_dr_shift_16(0x4303);//NOP
+  CLRTCLK;
+  jtag_ir_shift_8(IR_ADDR_CAPTURE);
+  jtag430_dr_shift_20(0x00000);
+}
+
+//! Release the CPU to run from its program counter.
+void jtag430x2_releasecpu(){
+  jtag_ir_shift_8(IR_CNTRL_SIG_16BIT);
+  jtag_dr_shift_16(0x0401);
+  jtag_ir_shift_8(IR_ADDR_CAPTURE);
+  jtag_ir_shift_8(IR_CNTRL_SIG_RELEASE);
+}
+
+/* A funclet is a short routine that the host has written into RAM,
+   such as a flash writer that copies a buffer into flash at the
+   speed of the flash controller rather than that of JTAG.  It ends
+   by writing a nonzero word to its mailbox and spinning on JMP $.
+   The host supplies how long to let it run; a POR then brings the
+   CPU back under JTAG control without clearing RAM.
+*/
+
+//! Run a funclet for ms milliseconds, returning its mailbox word.
+static unsigned int jtag430x2_funclet(unsigned long entry,
+				      unsigned long mailbox,
+				      unsigned int ms){
+  if(jtag430mode==MSP430MODE){
+    jtag430_haltcpu();
+    jtag430_setpc(entry);
+    jtag430_releasecpu();
+    msdelay(ms);
+    
+    jtag430_por();
+    jtag430_writemem(0x120,0x5a80);//disable watchdog
+    jtag430_haltcpu();
+    return jtag430_readmem(mailbox);
+  }
+  
+  jtag430x2_setpc(entry);
+  jtag430x2_releasecpu();
+  msdelay(ms);
+  
+  jtag430x2_syncpor();
+  return jtag430x2_readmem(mailbox);
+}
+
 //! Syncs a POR.
 unsigned int jtag430x2_syncpor(){
   jtag_ir_shift_8(IR_CNTRL_SIG_16BIT);
@@ -196,7 +369,9 @@ void jtag430x2_handle_fn( uint8_t const app,
   
   //jtag430_resettap();
   
-  if(verb!=START && jtag430mode==MSP430MODE){
+  //Block commands handle both modes themselves.
+  if(verb!=START && jtag430mode==MSP430MODE
+     && (verb<JTAG430X2_READBLOCK || verb>JTAG430X2_FUNCLET)){
     (*(jtag430_app.handle))(app,verb,len);
     return;
   }
@@ -274,6 +449,34 @@ void jtag430x2_handle_fn( uint8_t const app,
       serial_tx((val&0xFF00)>>8);
     }
     
+    break;
+  case JTAG430X2_READBLOCK:
+    //List of [start, end) regions, each a pair of 32-bit addresses.
+    if(!jtag430x2_burst_begin()){
+      txdata(app,NOK,0);
+      break;
+    }
+    for(i=0;i+8<=len;i+=8)
+      jtag430x2_readblock(app,cmddatalong[i>>2],cmddatalong[(i>>2)+1]);
+    SETTCLK;
+    txdata(app,OK,0);
+    break;
+  case JTAG430X2_WRITEBLOCK:
+    //32-bit address, then words to write.
+    if(len<6 || !jtag430x2_writeblock(cmddatalong[0],
+				      cmddataword+2,
+				      (len-4)>>1)){
+      txdata(app,NOK,0);
+      break;
+    }
+    txdata(app,verb,0);
+    break;
+  case JTAG430X2_FUNCLET:
+    //32-bit entry, 32-bit mailbox, 16-bit milliseconds to run.
+    cmddataword[0]=jtag430x2_funclet(cmddatalong[0],
+				     cmddatalong[1],
+				     cmddataword[4]);
+    txdata(app,verb,2);
     break;
   case JTAG430_COREIP_ID:
     cmddataword[0]=jtag430_coreid();
@@ -298,11 +501,18 @@ void jtag430x2_handle_fn( uint8_t const app,
     debugstr("Warning, not trying to halt for lack of code.");
     txdata(app,verb,0);
     break;
+  case JTAG430_SETPC:
+    jtag430x2_setpc(len>=4?cmddatalong[0]:cmddataword[0]);
+    txdata(app,verb,0);
+    break;
   case JTAG430_RELEASECPU:
+    jtag430x2_releasecpu();
+    txdata(app,verb,0);
+    break;
   case JTAG430_SETINSTRFETCH:
+  case JTAG430_PROFILE:
 
   case JTAG430_ERASEFLASH:
-  case JTAG430_SETPC:
     debugstr("This function is not yet implemented for MSP430X2.");
     debughex(verb);
     txdata(app,NOK,0);
@@ -308,6 +308,270 @@ void jtagarm7tdmi_set_register(unsigned long reg, unsigned long val) {
   jtagarm7_set_reg_prim(instr, reg, val);
 }
 
+//! Read r0-r(count-1) with a single debug-speed STM.  ARM state only.
+void jtagarm7_get_reg_multiple(unsigned long *regs, unsigned int count){
+  jtagarm7tdmi_nop( 0);
+  jtagarm7tdmi_instr_primitive(ARM_INSTR_STMIA_PC_r0_rx | ((1L<<count)-1), 0);
+  jtagarm7tdmi_nop( 0);                                 // decode
+  jtagarm7tdmi_nop( 0);                                 // execute
+  jtagarm7tdmi_nop( 0);
+  while (count--)
+    *regs++ = jtagarm7tdmi_nop( 0);                     // one register per scan
+}
+
+//! Write r0-r(count-1) with a single debug-speed LDM.  ARM state only.
+void jtagarm7_set_reg_multiple(const unsigned long *regs, unsigned int count){
+  jtagarm7tdmi_nop( 0);
+  jtagarm7tdmi_instr_primitive(ARM_INSTR_LDMIA_PC_r0_rx | ((1L<<count)-1), 0);
+  jtagarm7tdmi_nop( 0);                                 // decode
+  jtagarm7tdmi_nop( 0);                                 // execute
+  while (count--)
+    jtagarm7tdmi_instr_primitive(*regs++, 0);           // one register per scan
+  jtagarm7tdmi_nop( 0);
+  jtagarm7tdmi_nop( 0);
+}
+
+//! Capture r0-r15 and CPSR.  Thumb state falls back to one register at a time, without CPSR.
+void jtagarm7_get_registers(unsigned long *regs){
+  unsigned int i;
+  current_dbgstate = eice_read(EICE_DBGSTATUS);
+  if (current_dbgstate & JTAG_ARM7TDMI_DBG_TBIT){
+    for (i = 0; i <= ARM_REG_PC; i++)
+      regs[i] = jtagarm7tdmi_get_register(i);
+    regs[ARM_REG_CPSR] = 0;
+    return;
+  }
+  jtagarm7_get_reg_multiple(regs, ARM_REG_PC+1);
+  // MRS clobbers r0, which we already hold
+  jtagarm7tdmi_nop( 0);
+  jtagarm7tdmi_instr_primitive(ARM_INSTR_MRS_R0_CPSR, 0);
+  jtagarm7tdmi_nop( 0);
+  jtagarm7tdmi_nop( 0);
+  regs[ARM_REG_CPSR] = jtagarm7_get_reg_prim(ARM_READ_REG);
+  jtagarm7_set_reg_multiple(regs, 1);
+}
+
+//! Restore r0-r14, after CPSR if asked so that banked registers land in the restored mode.
+void jtagarm7_set_registers(unsigned long *regs, unsigned char restore_cpsr){
+  unsigned int i;
+  current_dbgstate = eice_read(EICE_DBGSTATUS);
+  if (current_dbgstate & JTAG_ARM7TDMI_DBG_TBIT){
+    for (i = 0; i < ARM_REG_PC; i++)
+      jtagarm7tdmi_set_register(i, regs[i]);
+    return;
+  }
+  if (restore_cpsr){
+    jtagarm7_set_reg_multiple(&regs[ARM_REG_CPSR], 1);
+    jtagarm7tdmi_nop( 0);
+    jtagarm7tdmi_instr_primitive(ARM_INSTR_MSR_cpsr_cxsf_R0, 0);
+    jtagarm7tdmi_nop( 0);
+    jtagarm7tdmi_nop( 0);
+  }
+  jtagarm7_set_reg_multiple(regs, ARM_REG_PC);
+}
+
+//! Wait for the core to re-enter debug state (DBGACK and nMREQ high).  Returns 0 on timeout.
+unsigned int jtagarm7_wait_dbg(unsigned int timeout){
+  current_dbgstate = eice_read(EICE_DBGSTATUS);
+  while (((current_dbgstate & 9L) != 9) && timeout > 0){
+    delay(1);
+    timeout --;
+    current_dbgstate = eice_read(EICE_DBGSTATUS);
+  }
+  return timeout;
+}
+
+//! Run one LDM/STM at system speed on r0-r(count-1), using r14 as the address.  Returns 0 on timeout.
+unsigned int jtagarm7_multiple_prim(unsigned long instr, unsigned long adr, unsigned int count){
+  jtagarm7tdmi_set_register(14, adr);
+  jtagarm7tdmi_nop( 1);                                 // BREAKPT, so the next instruction runs at MCLK
+  jtagarm7tdmi_instr_primitive(instr | ((1L<<count)-1), 0);
+  jtagarm_shift_ir(ARM7TDMI_IR_RESTART, 0);             // RESTART, the LDM/STM executes
+  return jtagarm7_wait_dbg(0xff);
+}
+
+//! Read a block of words, streaming them out as a single reply.  ARM state only; clobbers r0-r14.
+//  Words which could not be read (debug state never re-entered) are returned as 0xdeadbeef.
+void jtagarm7_readmem_block(uint8_t app, uint8_t verb, unsigned long adr, unsigned int count){
+  unsigned long words[ARM_MULTIPLE_MAXREGS];
+  unsigned int chunk, i;
+
+  if (count > ARM_READ_BLOCK_MAX)
+    count = ARM_READ_BLOCK_MAX;
+  txhead(app, verb, (unsigned long)count<<2);
+  while (count > 0){
+    chunk = (count > ARM_MULTIPLE_MAXREGS) ? ARM_MULTIPLE_MAXREGS : count;
+    if (jtagarm7_multiple_prim(ARM_LOAD_MULTIPLE, adr, chunk)){
+      jtagarm7_get_reg_multiple(words, chunk);
+      for (i = 0; i < chunk; i++)
+        txlong(words[i]);
+    } else {
+      for (i = 0; i < chunk; i++)
+        txlong(0xdeadbeefL);
+    }
+    count -= chunk;
+    adr += chunk<<2;
+  }
+}
+
+//! Write a block of words.  ARM state only; clobbers r0-r14.  Returns the number of words written.
+unsigned int jtagarm7_writemem_block(unsigned long adr, const unsigned long *data, unsigned int count){
+  unsigned int chunk, done = 0;
+
+  while (count > 0){
+    chunk = (count > ARM_MULTIPLE_MAXREGS) ? ARM_MULTIPLE_MAXREGS : count;
+    jtagarm7_set_reg_multiple(data, chunk);
+    if (!jtagarm7_multiple_prim(ARM_STORE_MULTIPLE, adr, chunk))
+      break;
+    done += chunk;
+    data += chunk;
+    count -= chunk;
+    adr += chunk<<2;
+  }
+  return done;
+}
+
+/************************* Debug Comms Channel ****************************/
+//! DCC download stub, position independent.  r0 = destination, r1 = word count.
+const unsigned long jtagarm7_dcc_stub[] = {
+  0xEE103E10L,                                          // loop: mrc p14, 0, r3, c0, c0  ; DCC control
+  0xE3130001L,                                          //       tst r3, #1              ; R bit, word waiting?
+  0x0AFFFFFCL,                                          //       beq loop
+  0xEE112E10L,                                          //       mrc p14, 0, r2, c1, c0  ; DCC data
+  0xE4802004L,                                          //       str r2, [r0], #4
+  0xE2511001L,                                          //       subs r1, r1, #1
+  0x1AFFFFF8L,                                          //       bne loop
+  0xEAFFFFFEL,                                          // done: b done
+};
+#define JTAGARM7_DCC_STUB_WORDS (sizeof(jtagarm7_dcc_stub)/sizeof(unsigned long))
+
+//! Wait for the stub to take the word in DBGCDR, the R bit (bit 0) of DBGCCR clearing.  Returns 0 on timeout.
+unsigned int jtagarm7_dcc_drained(){
+  unsigned int timeout = 0xff;
+  while ((eice_read(EICE_DBGCCR) & 1) && timeout > 0){
+    delay(1);
+    timeout --;
+  }
+  return timeout;
+}
+
+//! Feed words to the running stub, one chain 2 scan each.  Returns the number of words the stub took.
+//  Each word waits for the last to be read, so a slow MCLK or flash wait states can't overwrite one.
+unsigned int jtagarm7_dcc_write(const unsigned long *data, unsigned int count){
+  unsigned int i;
+  for (i = 0; i < count; i++){
+    if (!jtagarm7_dcc_drained())
+      return i ? i-1 : 0;                               // word i-1 is still waiting
+    eice_write(EICE_DBGCDR, data[i]);
+  }
+  if (!jtagarm7_dcc_drained())
+    return count ? count-1 : 0;
+  return count;
+}
+
+/************************* Watchpoint Trace ****************************/
+//  Watchpoint 0 is armed on an address range.  Each hit drops the core into debug state;
+//  we log the PC along with the address and data buses as chain 0 saw them, then branch back
+//  and RESTART, all without the host.  The ring keeps the newest records, counting any it drops.
+jtagarm7_trace_t jtagarm7_trace[JTAGARM7_TRACE_DEPTH];
+unsigned int jtagarm7_trace_head = 0, jtagarm7_trace_count = 0, jtagarm7_trace_lost = 0;
+unsigned long jtagarm7_trace_pcadj = 0;
+
+//! Capture the address and data buses through chain 0, without disturbing the core.
+void jtagarm7_chain0_capture(unsigned long *adr, unsigned long *data){
+  jtagarm7tdmi_scan(0, ARM7TDMI_IR_INTEST);
+  jtag_capture_dr();
+  jtag_shift_register();
+  *adr = jtag_trans_n(0L, 32, LSB| NOEND| NORETIDLE);
+  jtag_trans_n(0L, 9, MSB| NOEND| NORETIDLE);
+  jtag_trans_n(0L, 32, MSB| NOEND| NORETIDLE);
+  *data = jtag_trans_n(0L, 32, MSB);
+}
+
+//! Branch back to pc and leave debug state, as GoodFETARM7.resume() does in ARM state.
+void jtagarm7_resume(unsigned long pc){
+  jtagarm7tdmi_set_register(ARM_REG_PC, pc);
+  jtagarm7tdmi_nop( 0);
+  jtagarm7tdmi_nop( 1);                                 // BREAKPT, so the branch runs at MCLK
+  jtagarm7tdmi_instr_primitive(ARM_INSTR_B_IMM | 0xfffff0L, 0);
+  jtagarm7tdmi_nop( 0);
+  jtagarm_shift_ir(ARM7TDMI_IR_RESTART, 0);
+}
+
+//! Log one hit into the ring.  Returns the PC to resume at.
+unsigned long jtagarm7_trace_hit(){
+  jtagarm7_trace_t *rec = &jtagarm7_trace[jtagarm7_trace_head];
+
+  jtagarm7_chain0_capture(&rec->adr, &rec->data);
+  rec->pc = jtagarm7tdmi_get_register(ARM_REG_PC) + jtagarm7_trace_pcadj;
+  jtagarm7_trace_head = (jtagarm7_trace_head + 1) & (JTAGARM7_TRACE_DEPTH - 1);
+  if (jtagarm7_trace_count < JTAGARM7_TRACE_DEPTH)
+    jtagarm7_trace_count++;
+  else
+    jtagarm7_trace_lost++;
+  return rec->pc;
+}
+
+//! Arm watchpoint 0 on adr/adrmask for accesses matching ctrl/ctrlmask, and clear the ring.
+void jtagarm7_trace_start(unsigned long adr, unsigned long adrmask,
+                          unsigned long ctrl, unsigned long ctrlmask, unsigned long pcadj){
+  eice_write(EICE_WP0ADDR, adr);
+  eice_write(EICE_WP0ADDRMASK, adrmask);
+  eice_write(EICE_WP0DATA, 0);
+  eice_write(EICE_WP0DATAMASK, 0xffffffffL);            // any data value
+  eice_write(EICE_WP0CTRL, ctrl | EICE_WPCTRL_ENABLE);
+  eice_write(EICE_WP0CTRLMASK, ctrlmask);
+  jtagarm7_trace_head = jtagarm7_trace_count = jtagarm7_trace_lost = 0;
+  jtagarm7_trace_pcadj = pcadj;
+}
+
+//! Run the core until hits watchpoint hits are logged, or it runs timeout polls without one.
+//  Starts and ends in debug state, leaving the PC to resume at in *pc.  ARM state only;
+//  returns the number of hits logged.
+unsigned int jtagarm7_trace_run(unsigned int hits, unsigned int timeout, unsigned long *pc){
+  unsigned int done = 0;
+
+  current_dbgstate = eice_read(EICE_DBGSTATUS);
+  *pc = jtagarm7tdmi_get_register(ARM_REG_PC) + jtagarm7_trace_pcadj;
+  if (current_dbgstate & JTAG_ARM7TDMI_DBG_TBIT)
+    return 0;
+  while (done < hits){
+    jtagarm7_resume(*pc);
+    if (!jtagarm7_wait_dbg(timeout))
+      break;
+    *pc = jtagarm7_trace_hit();
+    done++;
+    if (current_dbgstate & JTAG_ARM7TDMI_DBG_TBIT)
+      return done;
+  }
+  if (done < hits){
+    // no hit in time, so pull the core back with DBGRQ
+    eice_write(EICE_DBGCTRL, JTAG_ARM7TDMI_DBG_DBGRQ);
+    jtagarm7_wait_dbg(0xff);
+    eice_write(EICE_DBGCTRL, 0);
+    *pc = jtagarm7tdmi_get_register(ARM_REG_PC) + jtagarm7_trace_pcadj;
+  }
+  return done;
+}
+
+//! Stream the ring, oldest first, emptying it: [count(2), lost(2), (pc, adr, data)...]
+void jtagarm7_trace_read(uint8_t app, uint8_t verb){
+  unsigned int i = (jtagarm7_trace_head - jtagarm7_trace_count) & (JTAGARM7_TRACE_DEPTH - 1);
+  jtagarm7_trace_t *rec;
+
+  txhead(app, verb, 4 + (unsigned long)jtagarm7_trace_count * sizeof(jtagarm7_trace_t));
+  txword(jtagarm7_trace_count);
+  txword(jtagarm7_trace_lost);
+  while (jtagarm7_trace_count){
+    rec = &jtagarm7_trace[i];
+    txlong(rec->pc);
+    txlong(rec->adr);
+    txlong(rec->data);
+    i = (i + 1) & (JTAGARM7_TRACE_DEPTH - 1);
+    jtagarm7_trace_count--;
+  }
+  jtagarm7_trace_lost = 0;
+}
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 //! Handles ARM7TDMI JTAG commands.  Forwards others to JTAG.
@@ -418,6 +682,55 @@ void jtagarm7_handle_fn( uint8_t const app,
     jtagarm7tdmi_set_register(cmddatalong[1], cmddatalong[0]);
     txdata(app,verb,4);
     break;
+  case JTAGARM7_GET_REGISTERS:
+    // -> r0-r15, CPSR
+    jtagarm7_get_registers(cmddatalong);
+    txdata(app,verb,ARM_CONTEXT_REGS*4);
+    break;
+  case JTAGARM7_SET_REGISTERS:
+    // [r0-r14, (CPSR)]
+    cmddatalong[ARM_REG_CPSR] = cmddatalong[ARM_REG_PC];
+    jtagarm7_set_registers(cmddatalong, len >= (ARM_REG_PC+1)*4);
+    txdata(app,verb,0);
+    break;
+  case JTAGARM7_READ_BLOCK:
+    // [adr(4), wordcount(4)] -> wordcount 32-bit words, at most ARM_READ_BLOCK_MAX
+    jtagarm7_readmem_block(app, verb, cmddatalong[0], cmddatalong[1]);
+    break;
+  case JTAGARM7_WRITE_BLOCK:
+    // [adr(4), words...] -> number of words written
+    cmddatalong[0] = jtagarm7_writemem_block(cmddatalong[0], &cmddatalong[1],
+                                             len < 4 ? 0 : (len-4)>>2);
+    txdata(app,verb,4);
+    break;
+  case JTAGARM7_DCC_LOAD_STUB:
+    // [adr(4)] -> stub length in words, 0 on failure
+    cmddatalong[0] = jtagarm7_writemem_block(cmddatalong[0], jtagarm7_dcc_stub, JTAGARM7_DCC_STUB_WORDS);
+    txdata(app,verb,4);
+    break;
+  case JTAGARM7_DCC_WRITE:
+    // [words...] -> number of words consumed by the stub
+    cmddatalong[0] = jtagarm7_dcc_write(cmddatalong, len>>2);
+    txdata(app,verb,4);
+    break;
+  case JTAGARM7_TRACE_START:
+    // [adr(4), adrmask(4), ctrl(4), ctrlmask(4), pcadj(4)]
+    jtagarm7_trace_start(cmddatalong[0], cmddatalong[1], cmddatalong[2], cmddatalong[3], cmddatalong[4]);
+    txdata(app,verb,0);
+    break;
+  case JTAGARM7_TRACE_RUN:
+    // [hits(2), timeout(2)] -> [hits logged(2), 0(2), resume pc(4)], the core back in debug state
+    cmddataword[0] = jtagarm7_trace_run(cmddataword[0], cmddataword[1], &cmddatalong[1]);
+    cmddataword[1] = 0;
+    txdata(app,verb,8);
+    break;
+  case JTAGARM7_TRACE_READ:
+    jtagarm7_trace_read(app, verb);
+    break;
+  case JTAGARM7_TRACE_STOP:
+    eice_write(EICE_WP0CTRL, 0);
+    txdata(app,verb,0);
+    break;
   case JTAG_RESET_TARGET:
     //FIXME: BORKEN
     debugstr("RESET TARGET");
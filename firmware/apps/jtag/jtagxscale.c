@@ -62,6 +62,201 @@ void jtag_xscale_reset_cpu(void)
 	msdelay(100);
 }
 
+/* IR length, 5 or 7 bits depending on the core's CoreGen */
+unsigned char jtag_xscale_irlen = 5;
+unsigned char jtag_xscale_last_ir = 0xFF;
+/* last value written to the DCSR and its control bits, shifted back in on reads */
+unsigned long jtag_xscale_dcsr_val = 0;
+unsigned char jtag_xscale_dcsr_ctrl = 0;
+
+/* shift a new instruction in, only if it differs from the last one */
+void jtag_xscale_shift_ir(unsigned char ir)
+{
+	if (jtag_xscale_last_ir == ir)
+		return;
+	jtag_capture_ir();
+	jtag_shift_register();
+	jtag_trans_n(ir, jtag_xscale_irlen, LSB);
+	jtag_xscale_last_ir = ir;
+}
+
+/* even parity bit of a word */
+unsigned char jtag_xscale_parity(unsigned long word)
+{
+	word ^= word >> 16;
+	word ^= word >> 8;
+	word ^= word >> 4;
+	word ^= word >> 2;
+	word ^= word >> 1;
+	return word & 1;
+}
+
+/* one 36-bit scan of the DCSR, DBGTX or DBGRX register: 3 control bits, 
+ * 32 data bits and a trailing bit.  The captured control bits are left in 
+ * *ctrl. */
+unsigned long jtag_xscale_scan36(unsigned char *ctrl, unsigned long data,
+								 unsigned char last)
+{
+	*ctrl = jtag_trans_n(*ctrl, 3, LSB | NOEND);
+	data = jtag_trans_n(data, 32, LSB | NOEND);
+	jtag_trans_n(last, 1, LSB);
+	return data;
+}
+
+/* scan the DCSR, returning the captured value */
+unsigned long jtag_xscale_dcsr(unsigned long dcsr, unsigned char ctrl)
+{
+	jtag_xscale_dcsr_val = dcsr;
+	jtag_xscale_dcsr_ctrl = ctrl;
+	jtag_xscale_shift_ir(XSCALE_IR_SELDCSR);
+	jtag_capture_dr();
+	jtag_shift_register();
+	return jtag_xscale_scan36(&ctrl, dcsr, 0);
+}
+
+/* load cache lines into the mini ICache
+ *
+ * data holds the eight words of each 32-byte line, little endian.  The host 
+ * sends a handler XSCALE_LOAD_IC_LINES lines to a packet. */
+unsigned int jtag_xscale_load_ic(unsigned long va, unsigned int lines,
+								 unsigned char invalidate, unsigned char *data)
+{
+	unsigned int line;
+	unsigned char i;
+	unsigned long word;
+
+	jtag_xscale_shift_ir(XSCALE_IR_LDIC);
+
+	if (invalidate)
+	{
+		jtag_capture_dr();
+		jtag_shift_register();
+		jtag_trans_n(XSCALE_LDIC_INVALIDATE_MINI_IC, 6, LSB | NOEND);
+		jtag_trans_n(0, 27, LSB);
+	}
+
+	for (line = 0; line < lines; line++, va += 32)
+	{
+		jtag_capture_dr();
+		jtag_shift_register();
+		jtag_trans_n(XSCALE_LDIC_LOAD_MINI_IC, 6, LSB | NOEND);
+		jtag_trans_n(va >> 5, 27, LSB);
+
+		for (i = 0; i < 8; i++)
+		{
+			word = (unsigned long)data[0] | ((unsigned long)data[1] << 8) |
+				((unsigned long)data[2] << 16) | ((unsigned long)data[3] << 24);
+			data += 4;
+			jtag_capture_dr();
+			jtag_shift_register();
+			jtag_trans_n(word, 32, LSB | NOEND);
+			jtag_trans_n(jtag_xscale_parity(word), 1, LSB);
+		}
+	}
+
+	/* give the cache a few clocks in run-test-idle */
+	CLRTMS;
+	for (i = 0; i < 30; i++)
+		jtag_tcktock();
+
+	return lines;
+}
+
+/* send a word to the debug handler, returning 0 on success */
+unsigned char jtag_xscale_write_rx(unsigned long word)
+{
+	unsigned int retries = XSCALE_POLL_RETRIES;
+	unsigned char ctrl;
+
+	jtag_xscale_shift_ir(XSCALE_IR_DBGRX);
+
+	/* wait for the handler to have read the last word */
+	do
+	{
+		ctrl = 0;
+		jtag_capture_dr();
+		jtag_shift_register();
+		jtag_xscale_scan36(&ctrl, word, 0);
+	} while ((ctrl & 1) && --retries);
+
+	if (!retries)
+		return 1;
+
+	/* then mark the word valid */
+	ctrl = 0;
+	jtag_capture_dr();
+	jtag_shift_register();
+	jtag_xscale_scan36(&ctrl, word, 1);
+	return 0;
+}
+
+/* receive a word from the debug handler, returning 0 on success */
+unsigned char jtag_xscale_read_tx(unsigned long *word)
+{
+	unsigned int retries = XSCALE_POLL_RETRIES;
+	unsigned char ctrl;
+
+	jtag_xscale_shift_ir(XSCALE_IR_DBGTX);
+
+	/* Capture-DR straight to Shift-DR consumes the word, if there is one */
+	do
+	{
+		ctrl = 0;
+		jtag_capture_dr();
+		jtag_shift_register();
+		*word = jtag_xscale_scan36(&ctrl, 0, 0);
+	} while (!(ctrl & 1) && --retries);
+
+	return retries ? 0 : 1;
+}
+
+/* stream a block of words read through the debug handler
+ *
+ * The reply is the words, zero after a handler timeout, followed by the 
+ * DCSR so that the host can check Sticky Abort. */
+void jtag_xscale_read_block(uint8_t app, uint8_t verb, unsigned long adr,
+							unsigned int count)
+{
+	unsigned int i;
+	unsigned char err;
+	unsigned long word = 0;
+
+	if (count > XSCALE_READ_MAX)
+		count = XSCALE_READ_MAX;
+
+	txhead(app, verb, ((unsigned long)count << 2) + 4);
+
+	err = jtag_xscale_write_rx(XSCALE_HANDLER_READ | 4) ||
+		jtag_xscale_write_rx(adr) ||
+		jtag_xscale_write_rx(count);
+
+	for (i = 0; i < count; i++)
+	{
+		if (!err)
+			err = jtag_xscale_read_tx(&word);
+		txlong(err ? 0 : word);
+	}
+	txlong(jtag_xscale_dcsr(jtag_xscale_dcsr_val, jtag_xscale_dcsr_ctrl));
+}
+
+/* write a block of words through the debug handler, returning the DCSR */
+unsigned long jtag_xscale_write_block(unsigned long adr, unsigned long *data,
+									  unsigned int count)
+{
+	unsigned int i;
+
+	if (jtag_xscale_write_rx(XSCALE_HANDLER_WRITE | 4) ||
+		jtag_xscale_write_rx(adr) ||
+		jtag_xscale_write_rx(count))
+		count = 0;
+
+	for (i = 0; i < count; i++)
+		if (jtag_xscale_write_rx(data[i]))
+			break;
+
+	return jtag_xscale_dcsr(jtag_xscale_dcsr_val, jtag_xscale_dcsr_ctrl);
+}
+
 /* Handles XScale JTAG commands.  Forwards others to JTAG. */
 void jtag_xscale_handle_fn( uint8_t const app,
 							uint8_t const verb,
@@ -74,14 +269,73 @@ void jtag_xscale_handle_fn( uint8_t const app,
 		jtag_setup();
 		/* reset to run-test-idle state */
 		jtag_reset_tap();
+		jtag_xscale_last_ir = 0xFF;
 		/* send back OK */
 		txdata(app, verb, 0);
 		break;
 
 	case START:
+		/* optional IR length, 7 on cores with a CoreGen of 2 */
+		if (len >= 1)
+			jtag_xscale_irlen = cmddata[0];
+		jtag_xscale_last_ir = 0xFF;
 		txdata(app, verb, 0);
 		break;
 
+	case XSCALE_DCSR:
+		/* [ctrl, dcsr32] writes, an empty packet just reads */
+		if (len >= 5)
+		{
+			cmddatalong[0] = jtag_xscale_dcsr(
+				cmddata[1] | ((unsigned long)cmddata[2] << 8) |
+				((unsigned long)cmddata[3] << 16) | ((unsigned long)cmddata[4] << 24),
+				cmddata[0]);
+		}
+		else
+		{
+			/* reads write back the last value written */
+			cmddatalong[0] = jtag_xscale_dcsr(jtag_xscale_dcsr_val, jtag_xscale_dcsr_ctrl);
+		}
+		txdata(app, verb, 4);
+		break;
+
+	case XSCALE_LOAD_IC:
+		/* [va32, invalidate], then whole lines */
+		if (len < 5 || (len - 5) % 32 || (len - 5) / 32 > XSCALE_LOAD_IC_LINES)
+		{
+			txdata(app, NOK, 0);
+			break;
+		}
+		cmddataword[0] = jtag_xscale_load_ic(cmddatalong[0], (len - 5) / 32,
+											 cmddata[4], cmddata + 5);
+		txdata(app, verb, 2);
+		break;
+
+	case XSCALE_DBGRX:
+		cmddata[0] = jtag_xscale_write_rx(cmddatalong[0]);
+		txdata(app, verb, 1);
+		break;
+
+	case XSCALE_DBGTX:
+		/* [word32, error] */
+		cmddata[8] = jtag_xscale_read_tx(&cmddatalong[1]);
+		cmddatalong[0] = cmddatalong[1];
+		cmddata[4] = cmddata[8];
+		txdata(app, verb, 5);
+		break;
+
+	case XSCALE_READ_BLOCK:
+		/* [adr32, count16] */
+		jtag_xscale_read_block(app, verb, cmddatalong[0], cmddataword[2]);
+		break;
+
+	case XSCALE_WRITE_BLOCK:
+		/* [adr32, words...] */
+		cmddatalong[0] = jtag_xscale_write_block(cmddatalong[0], &cmddatalong[1],
+												 len < 4 ? 0 : (len - 4) >> 2);
+		txdata(app, verb, 4);
+		break;
+
 	case STOP:
 		txdata(app, verb, 0);
 		break;
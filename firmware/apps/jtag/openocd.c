@@ -36,7 +36,9 @@ app_t const openocd_app = {
 static void openocd_tcktock() 
 {
 	CLRTCK; 
+	TCKWAIT;
 	SETTCK; 
+	TCKWAIT;
 }
 
 //! reset the cpu
@@ -121,6 +123,52 @@ void openocd_write(int tck, int tms, int tdi)
 		CLRTCK;
 }
 
+//! clocks a packed run of TMS/TDI pairs, packing TDO in place
+/*! cmddata is [count16, pairs...] with two bits per TCK, TDI low and
+    TMS high, four to a byte LSB first.  TDO is sampled with TCK low,
+    as OpenOCD's bitbang driver does, and packed eight to a byte LSB
+    first over the start of cmddata, which is behind the pairs still
+    to be read.  Returns the number of TDO bytes. */
+uint16_t openocd_scan(uint16_t count)
+{
+	uint16_t i;
+	uint8_t pairs = 0, tdo = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		if (!(i & 3))
+			pairs = cmddata[2 + (i >> 2)];
+
+		if (pairs & 2)
+			SETTMS;
+		else
+			CLRTMS;
+
+		if (pairs & 1)
+			SETMOSI;
+		else
+			CLRMOSI;
+		pairs >>= 2;
+
+		CLRTCK;
+		TCKWAIT;
+		if (READMISO)
+			tdo |= 1 << (i & 7);
+		SETTCK;
+		TCKWAIT;
+
+		if ((i & 7) == 7)
+		{
+			cmddata[i >> 3] = tdo;
+			tdo = 0;
+		}
+	}
+	if (i & 7)
+		cmddata[i >> 3] = tdo;
+
+	return (count + 7) >> 3;
+}
+
 //! Stop JTAG, release pins
 void openocd_stop()
 {
@@ -175,6 +223,22 @@ void openocd_handle_fn(uint8_t const app,
 			txdata(app,OK,0);
 			break;
 
+		case OPENOCD_SCAN:
+			// never clock more pairs than were sent
+			if (len < 2)
+				cmddataword[0] = 0;
+			else if (cmddataword[0] > ((len - 2) << 2))
+				cmddataword[0] = (len - 2) << 2;
+			txdata(app,OK,openocd_scan(cmddataword[0]));
+			break;
+
+		case JTAG_SET_TCK_DELAY:
+			if (len >= 2)
+				jtag_tck_delay = ntohs(cmddataword[0]);
+			cmddataword[0] = htons(jtag_tck_delay);
+			txdata(app,verb,2);
+			break;
+
 		case OPENOCD_LED:
 			openocd_led(cmddata[0]);
 			txdata(app,OK,0);
@@ -639,6 +639,13 @@ void sbw_handler_fn(u8 app, u8 verb, u32 len){
     txdata(app,verb,0);
     break;
     
+  case JTAG_SET_TCK_DELAY:
+    if (len >= 2)
+      jtag_tck_delay = ntohs(cmddataword[0]);
+    cmddataword[0] = htons(jtag_tck_delay);
+    txdata(app,verb,2);
+    break;
+
   case JTAG430_COREIP_ID:
   case JTAG430_DEVICE_ID:
     cmddataword[0]=0;
@@ -0,0 +1,245 @@
+/*! \file swd.c
+  \brief ARM Serial Wire Debug (SW-DP)
+
+  Bit-banged SWD on two pins.  A single SWD_TRANSFER carries a packed
+  list of DP/AP accesses, which are run back to back with WAIT retry,
+  and whose read results come back in one reply.
+*/
+
+#include "platform.h"
+#include "command.h"
+#include "swd.h"
+
+//! Handles SWD commands.
+void swd_handle_fn( uint8_t const app,
+                    uint8_t const verb,
+                    uint32_t const len);
+
+// define the swd app's app_t
+app_t const swd_app = {
+
+	/* app number */
+	SWD,
+
+	/* handle fn */
+	swd_handle_fn,
+
+	/* name */
+	"SWD",
+
+	/* desc */
+	"\tThe SWD app talks Serial Wire Debug to ARM Cortex\n"
+	"\tdevices, with packed multi-transfer commands.\n"
+};
+
+/**** 20-pin Connection Information ****
+GoodFET  ->  ARM 20-pin connector
+  2               1  (Vdd)
+  5               7  (SWDIO/TMS)
+  7               9  (SWCLK/TCK)
+  9               4,6,8,10,12,14,16,18,20 (GND)
+********************************/
+
+//! The target samples SWDIO on the rising edge of SWCLK, and drives it there too.
+#define SWDCLK do { SPIOUT&=~SWCLK; SPIOUT|=SWCLK; } while (0)
+
+//! Shift bits out, LSB first.
+void swd_write_bits(unsigned long word, unsigned char bits){
+  while (bits--){
+    SPIOUT&=~SWCLK;
+    if (word & 1)
+      SPIOUT|=SWDIO;
+    else
+      SPIOUT&=~SWDIO;
+    word >>= 1;
+    SPIOUT|=SWCLK;
+  }
+}
+
+//! Shift bits in, LSB first.
+unsigned long swd_read_bits(unsigned char bits){
+  unsigned long word = 0, mask = 1;
+  while (bits--){
+    SPIOUT&=~SWCLK;
+    if (SWD_READ)
+      word |= mask;
+    mask <<= 1;
+    SPIOUT|=SWCLK;
+  }
+  return word;
+}
+
+unsigned char swd_parity(unsigned long word){
+  word ^= word>>16;
+  word ^= word>>8;
+  word ^= word>>4;
+  word ^= word>>2;
+  word ^= word>>1;
+  return word & 1;
+}
+
+void swd_setup(void){
+  SPIOUT|=SWCLK|SWDIO;
+  SPIDIR|=SWCLK|SWDIO;
+  msdelay(100);
+}
+
+void swd_line_reset(void){
+  swd_write_bits(0xffffffffL, 32);                      // at least 50 cycles high
+  swd_write_bits(0xffffffffL, 24);
+  swd_write_bits(0xE79EL, 16);                          // JTAG-to-SWD select sequence
+  swd_write_bits(0xffffffffL, 32);
+  swd_write_bits(0xffffffffL, 24);
+  swd_write_bits(0, 8);                                 // idle; IDCODE must be read next
+}
+
+//! One attempt at a transfer, no retry.
+unsigned char swd_xfer_once(unsigned char req, unsigned long *data){
+  unsigned char ack;
+
+  req &= SWD_REQ_APnDP|SWD_REQ_RnW|SWD_REQ_A32;
+  // start, APnDP, RnW, A[2:3], parity, stop, park
+  swd_write_bits(0x81 | (req<<1) | (swd_parity(req)<<5), 8);
+  SWDIO_RELEASE;
+  SWDCLK;                                               // turnaround
+  ack = swd_read_bits(3);
+
+  if (ack != SWD_ACK_OK){
+    SWDCLK;                                             // no data phase, turn back around
+    SWDIO_DRIVE;
+    return ack;
+  }
+
+  if (req & SWD_REQ_RnW){
+    *data = swd_read_bits(32);
+    if (swd_read_bits(1) != swd_parity(*data))
+      ack = SWD_ACK_PARITY;
+    SWDCLK;                                             // turnaround
+    SWDIO_DRIVE;
+  } else {
+    SWDCLK;                                             // turnaround
+    SWDIO_DRIVE;
+    swd_write_bits(*data, 32);
+    swd_write_bits(swd_parity(*data), 1);
+  }
+  swd_write_bits(0, SWD_IDLE_CYCLES);
+  return ack;
+}
+
+unsigned char swd_xfer(unsigned char req, unsigned long *data){
+  unsigned char ack;
+  unsigned int retries = SWD_WAIT_RETRIES;
+  unsigned long abort = SWD_ABORT_CLEAR;
+
+  do {
+    ack = swd_xfer_once(req, data);
+  } while (ack == SWD_ACK_WAIT && --retries);
+
+  if (ack == SWD_ACK_FAULT)
+    swd_xfer_once(SWD_REQ_ABORT, &abort);              // ABORT is always accepted
+  return ack;
+}
+
+//! Run a packed list of transfers, streaming read results as a single reply.
+/*! Reply is one word per read request, in order, then a status word
+    of the last ACK in the low byte and the number of completed
+    requests in the high half.  Reads after a failure are zero.
+
+    AP reads are posted, so each returns the previous AP read's data.
+    This is hidden from the host: runs of AP reads are pipelined and
+    only the last is followed by an RDBUFF read.
+*/
+void swd_transfer(uint8_t app, uint8_t verb, unsigned int len){
+  unsigned int i, reads = 0, sent = 0, done = 0;
+  unsigned char req, ack = SWD_ACK_OK, pending = 0;
+  unsigned long val;
+
+  for (i = 0; i < len; ){
+    req = cmddata[i++];
+    if (req & SWD_REQ_RnW)
+      reads++;
+    else
+      i += 4;
+  }
+  txhead(app, verb, ((unsigned long)reads<<2) + 4);
+
+  i = 0;
+  while (i < len){
+    req = cmddata[i++];
+    if (!(req & SWD_REQ_RnW)){
+      val = cmddata[i] | ((unsigned long)cmddata[i+1]<<8)
+        | ((unsigned long)cmddata[i+2]<<16) | ((unsigned long)cmddata[i+3]<<24);
+      i += 4;
+    }
+    if (pending && (req & SWD_REQ_AP_READ) != SWD_REQ_AP_READ){
+      // anything else could disturb the pipeline, collect the last AP read first
+      unsigned long rd;
+      ack = swd_xfer(SWD_REQ_RDBUFF, &rd);
+      if (ack != SWD_ACK_OK)
+        break;
+      txlong(rd);
+      sent++;
+      pending = 0;
+    }
+    ack = swd_xfer(req, &val);
+    if (ack != SWD_ACK_OK)
+      break;
+    if ((req & SWD_REQ_AP_READ) == SWD_REQ_AP_READ){
+      if (pending){
+        txlong(val);
+        sent++;
+      }
+      pending = 1;
+    } else if (req & SWD_REQ_RnW){
+      txlong(val);
+      sent++;
+    }
+    done++;
+  }
+  if (pending && ack == SWD_ACK_OK){
+    ack = swd_xfer(SWD_REQ_RDBUFF, &val);
+    if (ack == SWD_ACK_OK){
+      txlong(val);
+      sent++;
+    }
+  }
+  while (sent++ < reads)
+    txlong(0);
+  txlong(ack | ((unsigned long)done<<16));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Handles SWD commands.
+void swd_handle_fn( uint8_t const app,
+                    uint8_t const verb,
+                    uint32_t const len)
+{
+  switch(verb){
+  case SETUP:
+    swd_setup();
+    txdata(app,verb,0);
+    break;
+  case START:
+    //Enter SWD mode and return the IDCODE.
+    swd_setup();
+    //fall through
+  case SWD_LINE_RESET:
+    swd_line_reset();
+    if (swd_xfer(SWD_REQ_IDCODE, &cmddatalong[0]) != SWD_ACK_OK){
+      txdata(app,NOK,0);
+      break;
+    }
+    txdata(app,verb,4);
+    break;
+  case SWD_TRANSFER:
+    swd_transfer(app, verb, len);
+    break;
+  case STOP:
+    SWDIO_RELEASE;
+    SPIOUT&=~(SWCLK|SWDIO);
+    txdata(app,verb,0);
+    break;
+  default:
+    txdata(app,NOK,0);
+  }
+}
@@ -0,0 +1,408 @@
+/*! \file xsvf.c
+  \brief XSVF player
+
+  Plays Xilinx XSVF (XAPP503) on the JTAG pins as it streams in.  The
+  host sends the file in XSVF_DATA chunks of any size; instructions
+  whose operands straddle a chunk are held until the rest arrives, so
+  no more than one instruction's worth of state is kept on the FET.
+*/
+
+#include "platform.h"
+#include "command.h"
+#include "jtag.h"
+#include "xsvf.h"
+
+//! Handles XSVF commands.  Forwards others to JTAG.
+void xsvf_handle_fn( uint8_t const app,
+                     uint8_t const verb,
+                     uint32_t const len);
+
+// define the xsvf app's app_t
+app_t const xsvf_app = {
+
+	/* app number */
+	XSVF,
+
+	/* handle fn */
+	xsvf_handle_fn,
+
+	/* name */
+	"XSVF",
+
+	/* desc */
+	"\tThe XSVF app plays streamed XSVF files, for programming\n"
+	"\tCPLDs and FPGAs over JTAG.\n"
+};
+
+#define XSVF_NOCMD  0xff
+
+//Shift flags
+#define XSVF_EXIT     1       // leave Shift-xR for the end state afterward
+#define XSVF_COMPARE  2       // check TDO against the expected vector
+#define XSVF_RETRY    4       // XSDR-style retry on mismatch
+
+unsigned char xsvf_status = XSVF_RUNNING;
+unsigned char xsvf_cmd = XSVF_NOCMD;     // instruction being collected
+unsigned char xsvf_failcmd = XSVF_NOCMD; // instruction that stopped the player
+unsigned long xsvf_count = 0;            // instructions executed
+unsigned int xsvf_have = 0;              // operand bytes collected
+
+unsigned int xsvf_sdrbits = 0;
+unsigned long xsvf_runtest = 0;
+unsigned char xsvf_repeat = 32;
+unsigned char xsvf_endir = 1;            // Run-Test/Idle
+unsigned char xsvf_enddr = 1;
+unsigned char xsvf_tap = 0;              // TAP state, in XSVF numbering
+
+//! Operands of the current instruction; XSDRTDO needs two vectors.
+unsigned char xsvf_buf[2*XSVF_MAXBYTES+4];
+unsigned char xsvf_tdomask[XSVF_MAXBYTES];
+unsigned char xsvf_tdoexp[XSVF_MAXBYTES];
+unsigned char xsvf_tdocap[XSVF_MAXBYTES];
+
+//! Next TAP state for TMS=0 and TMS=1, in XSVF numbering (jtag_state is 1<<n).
+const unsigned char xsvf_next[16][2] = {
+  { 1,  0}, { 1,  2}, { 3,  9}, { 4,  5},   // TLR, RTI, Select-DR, Capture-DR
+  { 4,  5}, { 6,  8}, { 6,  7}, { 4,  8},   // Shift-DR, Exit1-DR, Pause-DR, Exit2-DR
+  { 1,  2}, {10,  0}, {11, 12}, {11, 12},   // Update-DR, Select-IR, Capture-IR, Shift-IR
+  {13, 15}, {13, 14}, {11, 15}, { 1,  2},   // Exit1-IR, Pause-IR, Exit2-IR, Update-IR
+};
+
+#define xsvf_bytes(bits) (((bits)+7)>>3)
+
+//! Big-endian long from the operand buffer.
+unsigned long xsvf_long(const unsigned char *p){
+  return ((unsigned long)p[0]<<24) | ((unsigned long)p[1]<<16)
+    | ((unsigned int)p[2]<<8) | p[3];
+}
+
+//! One TCK with the given TMS, tracking the TAP.
+void xsvf_tms(unsigned char tms){
+  if (tms)
+    SETTMS;
+  else
+    CLRTMS;
+  jtag_tcktock();
+  xsvf_tap = xsvf_next[xsvf_tap][tms];
+}
+
+//! Walk the TAP to a state, by the shortest path XAPP058 would take.
+void xsvf_goto(unsigned char state){
+  unsigned char base, r, t, tms;
+
+  if (state == 0){
+    // TLR is always entered, even from TLR
+    for (r = 0; r < 5; r++)
+      xsvf_tms(1);
+  }
+  while (xsvf_tap != state){
+    switch (xsvf_tap){
+    case 0:  tms = 0; break;
+    case 1:  tms = 1; break;
+    case 2:  tms = (state >= 9); break;
+    case 9:  tms = (state < 9); break;
+    default:
+      // Capture..Update of either column, the IR column offset by 7
+      base = (xsvf_tap >= 10) ? 7 : 0;
+      r = xsvf_tap - base;
+      t = state - base;
+      switch (r){
+      case 3:  tms = (t != 4); break;
+      case 5:  tms = (t != 6); break;
+      case 7:  tms = (t != 4); break;
+      case 8:  tms = (state != 1); break;
+      default: tms = 1;                   // Shift and Pause only leave by TMS=1
+      }
+    }
+    xsvf_tms(tms);
+  }
+  CLRTMS;
+  jtag_state = 1U<<xsvf_tap;
+}
+
+//! Idle for a number of microseconds, clocking TCK as we go.
+void xsvf_wait(unsigned long us){
+  CLRTMS;
+  while (us--){
+    jtag_tcktock();
+    delay_us(1);
+  }
+}
+
+//! Shift a vector, last byte first and LSB first, capturing TDO.
+void xsvf_shift(const unsigned char *tdi, unsigned int bits, unsigned char exit){
+  unsigned int i, n = xsvf_bytes(bits);
+  unsigned char in, out, bit;
+
+  CLRTMS;
+  for (i = 0; i < n; i++){
+    in = tdi[n-1-i];
+    out = 0;
+    for (bit = 0; bit < 8 && bits; bit++, bits--){
+      if (in & (1<<bit))
+        SETMOSI;
+      else
+        CLRMOSI;
+      if (bits == 1 && exit)
+        SETTMS;                           // last bit leaves Shift-xR
+      CLRTCK;
+      led_toggle();
+      TCKWAIT;
+      if (READMISO)
+        out |= 1<<bit;
+      SETTCK;
+      led_toggle();
+      TCKWAIT;
+    }
+    xsvf_tdocap[n-1-i] = out;
+  }
+  if (exit)
+    xsvf_tap = xsvf_next[xsvf_tap][1];
+  CLRTMS;
+}
+
+//! Does the captured TDO differ from the expected value under the mask?
+unsigned char xsvf_mismatch(unsigned int n){
+  while (n--)
+    if ((xsvf_tdocap[n] ^ xsvf_tdoexp[n]) & xsvf_tdomask[n])
+      return 1;
+  return 0;
+}
+
+//! Shift a DR or IR vector, with the retry loop of XAPP058 for XSDR.
+unsigned char xsvf_scan(const unsigned char *tdi, unsigned int bits, unsigned char shift,
+                        unsigned char end, unsigned char flags, unsigned long runtest){
+  unsigned char attempt = 0, mismatch;
+
+  for (;;){
+    xsvf_goto(shift);
+    xsvf_shift(tdi, bits, flags & XSVF_EXIT);
+    mismatch = (flags & XSVF_COMPARE) && xsvf_mismatch(xsvf_bytes(bits));
+    if (flags & XSVF_EXIT){
+      if (mismatch && (flags & XSVF_RETRY) && runtest && attempt < xsvf_repeat){
+        // Pause and go back to Shift-DR, shifting one more bit, and wait longer
+        xsvf_goto(shift+2);
+        xsvf_goto(shift);
+        runtest += runtest>>2;
+      } else {
+        xsvf_goto(end);
+      }
+      if (runtest){
+        xsvf_goto(1);
+        xsvf_wait(runtest);
+      }
+    }
+    if (!mismatch || !(flags & XSVF_RETRY) || attempt++ >= xsvf_repeat)
+      break;
+  }
+  return mismatch ? XSVF_ERROR_MISMATCH : XSVF_RUNNING;
+}
+
+//! Operand bytes the current instruction needs, given what has arrived so far.
+unsigned int xsvf_length(void){
+  unsigned int n = xsvf_bytes(xsvf_sdrbits);
+
+  switch (xsvf_cmd){
+  case XCOMPLETE:
+    return 0;
+  case XTDOMASK: case XSDR:
+  case XSDRB: case XSDRC: case XSDRE:
+    return n;
+  case XSDRTDO:
+  case XSDRTDOB: case XSDRTDOC: case XSDRTDOE:
+    return 2*n;
+  case XSIR:
+    return xsvf_have < 1 ? 1 : 1 + xsvf_bytes(xsvf_buf[0]);
+  case XSIR2:
+    return xsvf_have < 2 ? 2 : 2 + xsvf_bytes(((unsigned int)xsvf_buf[0]<<8) | xsvf_buf[1]);
+  case XRUNTEST: case XSDRSIZE:
+    return 4;
+  case XREPEAT: case XSTATE: case XENDIR: case XENDDR:
+    return 1;
+  case XWAIT:
+    return 6;
+  }
+  return 0;
+}
+
+//! Run the collected instruction.
+unsigned char xsvf_exec(void){
+  unsigned char *b = xsvf_buf;
+  unsigned int n = xsvf_bytes(xsvf_sdrbits), bits, i;
+
+  switch (xsvf_cmd){
+  case XCOMPLETE:
+    return XSVF_COMPLETE;
+  case XTDOMASK:
+    for (i = 0; i < n; i++)
+      xsvf_tdomask[i] = b[i];
+    break;
+  case XSIR:
+  case XSIR2:
+    bits = (xsvf_cmd == XSIR) ? b[0] : ((unsigned int)b[0]<<8) | b[1];
+    b += (xsvf_cmd == XSIR) ? 1 : 2;
+    if (bits > XSVF_MAXBITS)
+      return XSVF_ERROR_TOOBIG;
+    return xsvf_scan(b, bits, 11, xsvf_endir, XSVF_EXIT, xsvf_runtest);
+  case XSDRTDO:
+    for (i = 0; i < n; i++)
+      xsvf_tdoexp[i] = b[n+i];
+    //fall through
+  case XSDR:
+    return xsvf_scan(b, xsvf_sdrbits, 4, xsvf_enddr,
+                     XSVF_EXIT | XSVF_COMPARE | XSVF_RETRY, xsvf_runtest);
+  case XSDRB:
+  case XSDRC:
+    return xsvf_scan(b, xsvf_sdrbits, 4, 4, 0, 0);
+  case XSDRE:
+    return xsvf_scan(b, xsvf_sdrbits, 4, xsvf_enddr, XSVF_EXIT, 0);
+  case XSDRTDOB:
+  case XSDRTDOC:
+  case XSDRTDOE:
+    for (i = 0; i < n; i++)
+      xsvf_tdoexp[i] = b[n+i];
+    return xsvf_scan(b, xsvf_sdrbits, 4, xsvf_enddr,
+                     XSVF_COMPARE | (xsvf_cmd == XSDRTDOE ? XSVF_EXIT : 0), 0);
+  case XRUNTEST:
+    xsvf_runtest = xsvf_long(b);
+    break;
+  case XREPEAT:
+    xsvf_repeat = b[0];
+    break;
+  case XSDRSIZE:
+    if (xsvf_long(b) > XSVF_MAXBITS)
+      return XSVF_ERROR_TOOBIG;
+    xsvf_sdrbits = xsvf_long(b);
+    break;
+  case XSTATE:
+    if (b[0] > 15)
+      return XSVF_ERROR_ILLEGALCMD;
+    xsvf_goto(b[0]);
+    break;
+  case XENDIR:
+    xsvf_endir = b[0] ? 13 : 1;          // Pause-IR or Run-Test/Idle
+    break;
+  case XENDDR:
+    xsvf_enddr = b[0] ? 6 : 1;           // Pause-DR or Run-Test/Idle
+    break;
+  case XWAIT:
+    if (b[0] > 15 || b[1] > 15)
+      return XSVF_ERROR_ILLEGALCMD;
+    xsvf_goto(b[0]);
+    xsvf_wait(xsvf_long(b+2));
+    xsvf_goto(b[1]);
+    break;
+  default:
+    //XSETSDRMASKS and XSDRINC are deprecated, and never emitted by iMPACT.
+    return XSVF_ERROR_ILLEGALCMD;
+  }
+  return XSVF_RUNNING;
+}
+
+//! Reset the player and the TAP.
+void xsvf_start(void){
+  unsigned int i;
+
+  jtag_setup();
+  prep_timer();
+  xsvf_status = XSVF_RUNNING;
+  xsvf_cmd = xsvf_failcmd = XSVF_NOCMD;
+  xsvf_count = 0;
+  xsvf_have = 0;
+  xsvf_sdrbits = 0;
+  xsvf_runtest = 0;
+  xsvf_repeat = 32;
+  xsvf_endir = xsvf_enddr = 1;
+  for (i = 0; i < XSVF_MAXBYTES; i++)
+    xsvf_tdomask[i] = xsvf_tdoexp[i] = xsvf_tdocap[i] = 0;
+  CLRMOSI;
+  xsvf_tap = 1;
+  xsvf_goto(0);
+  xsvf_goto(1);
+}
+
+//! Run a chunk of the XSVF stream.  Returns the player status.
+unsigned char xsvf_feed(const unsigned char *data, unsigned int len){
+  unsigned int need;
+
+  while (len && xsvf_status == XSVF_RUNNING){
+    if (xsvf_cmd == XSVF_NOCMD){
+      xsvf_cmd = *data++;
+      len--;
+      xsvf_have = 0;
+    }
+    if (xsvf_cmd == XCOMMENT){
+      // NUL-terminated, and of any length, so skip it rather than buffer it
+      while (len && (len--, *data++))
+        ;
+      if (len || data[-1] == 0)
+        xsvf_cmd = XSVF_NOCMD;
+      continue;
+    }
+    while ((need = xsvf_length()) > xsvf_have && len){
+      if (need > sizeof(xsvf_buf)){
+        xsvf_status = XSVF_ERROR_TOOBIG;
+        break;
+      }
+      xsvf_buf[xsvf_have++] = *data++;
+      len--;
+    }
+    if (xsvf_status != XSVF_RUNNING || need > xsvf_have)
+      break;
+
+    xsvf_status = xsvf_exec();
+    if (xsvf_status == XSVF_RUNNING || xsvf_status == XSVF_COMPLETE)
+      xsvf_count++;
+    if (xsvf_status != XSVF_RUNNING)
+      xsvf_failcmd = xsvf_cmd;
+    xsvf_cmd = XSVF_NOCMD;
+  }
+  if (xsvf_status != XSVF_RUNNING && xsvf_failcmd == XSVF_NOCMD)
+    xsvf_failcmd = xsvf_cmd;
+  return xsvf_status;
+}
+
+//! Report the player status, and the vectors of a failed comparison.
+/*! Reply is the status, the last instruction, the SDR size in bytes
+    and the count of instructions run, followed by the captured,
+    expected and mask vectors of the SDR size.
+*/
+void xsvf_report(uint8_t app, uint8_t verb){
+  unsigned int i, n = xsvf_bytes(xsvf_sdrbits);
+
+  txhead(app, verb, 8 + 3*n);
+  serial_tx(xsvf_status);
+  serial_tx(xsvf_failcmd);
+  txword(n);
+  txlong(xsvf_count);
+  for (i = 0; i < n; i++)
+    serial_tx(xsvf_tdocap[i]);
+  for (i = 0; i < n; i++)
+    serial_tx(xsvf_tdoexp[i]);
+  for (i = 0; i < n; i++)
+    serial_tx(xsvf_tdomask[i]);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Handles XSVF commands.  Forwards others to JTAG.
+void xsvf_handle_fn( uint8_t const app,
+                     uint8_t const verb,
+                     uint32_t const len)
+{
+  switch(verb){
+  case START:
+  case SETUP:
+    xsvf_start();
+    txdata(app,verb,0);
+    break;
+  case XSVF_DATA:
+    cmddata[0] = xsvf_feed(cmddata, len);
+    txdata(app,verb,1);
+    break;
+  case XSVF_STATUS:
+    xsvf_report(app,verb);
+    break;
+  default:
+    (*(jtag_app.handle))(app,verb,len);
+  }
+}
@@ -200,7 +200,7 @@ $(error Please define board, as explained in the README)
 endif
 #platform := $(board)
 
-AVAILABLE_APPS = monitor spi jtag sbw jtag430 jtag430x2 i2c jtagarm7 ejtag jtagxscale openocd chipcon avr pic adc nrf ccspi glitch smartcard ps2 slc2  maxusb atmel_radio cc2500
+AVAILABLE_APPS = monitor spi jtag sbw jtag430 jtag430x2 i2c jtagarm7 ejtag jtagxscale openocd chipcon avr pic adc nrf ccspi glitch smartcard ps2 slc2  maxusb atmel_radio cc2500 adiv5 swd xsvf
 
 # defaults
 CONFIG_monitor    ?= y
@@ -227,6 +227,9 @@ CONFIG_smartcard  ?= n
 CONFIG_ps2        ?= n
 CONFIG_slc2       ?= n
 CONFIG_atmel_radio ?=n
+CONFIG_adiv5      ?= n
+CONFIG_swd        ?= n
+CONFIG_xsvf       ?= n
 
 #The CONFIG_foo vars are only interpreted if $(config) is "unset".
 ifeq ($(config),undef)
@@ -24,10 +24,37 @@
 #define CCCMD_RESUME 0x4C
 #define CCCMD_STEP_INSTR 0x5C
 #define CCCMD_DEBUG_INSTR 0x54
+//0x80-0x87, low bits are length[10:8]; CC253x and later.
+#define CCCMD_BURST_WRITE 0x80
+
+//CC253x XDATA registers for DMA flash writes.
+#define CC253X_DBGDATA 0x6260
+#define CC253X_FCTL 0x6270
+#define CC253X_FADDRL 0x6271
+#define CC253X_FADDRH 0x6272
+#define CC253X_FWDATA 0x6273
+
+//FCTL bits
+#define CC253X_FCTL_BUSY 0x80
+#define CC253X_FCTL_ABORT 0x20
+#define CC253X_FCTL_ERASE 0x01
+//WRITE with the cache enabled
+#define CC253X_FCTL_WRITE 0x06
+
+//DMA triggers
+#define CC_DMA_TRIG_FLASH 18
+#define CC_DMA_TRIG_DBG_BW 31
 
 //! Flash Word Size
 extern u8 flash_word_size;
 
+//! Extra delay() count in each DC half period, 0 for full speed.
+extern u16 cc_clk_delay;
+
+//Auto-tune defaults: checks per candidate delay, and the slowest tried.
+#define CC_TUNE_ITERATIONS 8
+#define CC_TUNE_SLOWEST 0x100
+
 //! Erase a chipcon chip.
 void cc_chip_erase();
 //! Write the configuration byte.
@@ -52,6 +79,8 @@ unsigned char cc_peekdatabyte(unsigned int adr);
 u8 cc_peekirambyte(u8 adr);
 //! Write a byte of IRAM.
 u8 cc_pokeirambyte(u8 adr, u8 val);
+//! Stream a block of code memory to the host.
+void cc_readcodeblock(u8 app, u8 verb, u32 adr, u16 len);
 //! Set a byte of data memory.
 unsigned char cc_pokedatabyte(unsigned int adr,
 			      unsigned char val);
@@ -69,6 +98,14 @@ void cc_write_xdata(u16 adr, u8 *data, u16 len);
 void cc_write_flash_page(u32 adr);
 //! Set the Chipcon's Program Counter
 void cc_set_pc(u32 adr);
+//! Write a block of flash through BURST_WRITE and DMA, on CC253x.
+u8 cc_write_flash_dma(u32 adr, u16 buf, u8 erase, u8 *data, u16 len);
+//! Find the shortest DC half period that reads back reliably.
+u16 cc_autotune(u8 iterations, u16 slowest);
+//! Sample a byte of XDATA at a fixed interval into cmddata.
+void cc_sample_xdata(u16 adr, u16 interval, u16 count);
+//! Single-step the target, streaming a trace of its PC.
+void cc_trace(u8 app, u8 verb, u32 count, u16 lo, u16 hi, u8 regs);
 
 //! Halt the CPU.
 void cc_halt();
@@ -113,6 +150,16 @@ void cc_lockchip();
 #define CC_PROGRAM_FLASH 0x98
 #define CC_WIPEFLASHBUFFER 0x99
 #define CC_LOCKCHIP 0x9A
+#define CC_READ_CODE_BLOCK 0x9B
+#define CC_WRITE_XDATA_BLOCK 0x9C
+#define CC_WRITE_FLASH_DMA 0x9D
+#define CC_TRACE 0x9E
+#define CC_CLOCK_DELAY 0x9F
+#define CC_AUTOTUNE 0xA0
+#define CC_SAMPLE_XDATA 0xA1
+
+//CC_TRACE flags
+#define CC_TRACE_REGS 0x01
 
 extern app_t const chipcon_app;
 
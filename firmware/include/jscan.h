@@ -14,7 +14,7 @@
 
 /* limits */
 #define JSCAN_LIMIT_PINS	254
-#define JSCAN_DEFAULT_DELAY	1
+#define JSCAN_DEFAULT_DELAY	1	/* half TCK period, microseconds */
 
 /* endianness */
 #define JSCAN_ENDIAN_BIG	0
@@ -33,6 +33,11 @@
 #define JSCAN_CMD_LISTPIN	(JSCAN_CMD + 8)
 #define JSCAN_CMD_RESULTS	(JSCAN_CMD + 9)
 
+/* replies streamed during JSCAN_CMD_SCAN */
+#define JSCAN_CMD_PROGRESS	(JSCAN_CMD + 10)	/* nrst, tck pins done, npins */
+#define JSCAN_CMD_HIT		(JSCAN_CMD + 11)	/* tck, tms, tdi, tdo, nrst, idcode32; 0xff for none */
+#define JSCAN_CMD_DONE		(JSCAN_CMD + 12)	/* number of hits */
+
 extern app_t const jscan_app;
 
 #endif 
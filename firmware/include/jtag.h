@@ -37,6 +37,20 @@ extern unsigned char jtagid;
 //! the global state of the JTAG TAP
 extern enum eTAPState jtag_state;
 
+//! Most TAPs the cached chain model holds
+#ifndef JTAG_CHAIN_MAX
+#define JTAG_CHAIN_MAX 8
+#endif
+
+//! Number of TAPs in the cached chain, 0 until scanned
+extern uint8_t jtag_chain_len;
+//! TAP that IR/DR shifts are aimed at, 0 nearest TDO
+extern uint8_t jtag_chain_target;
+//! IR length of each TAP
+extern uint8_t jtag_chain_irlen[JTAG_CHAIN_MAX];
+//! IDCODE of each TAP, 0 for those without one
+extern uint32_t jtag_chain_idcode[JTAG_CHAIN_MAX];
+
 //! Returns true if we're in any of the data register states
 int in_dr();
 //! Returns true if we're in any of the instruction register states
@@ -91,6 +105,14 @@ uint16_t jtag_detect_ir_width();
 uint16_t jtag_detect_chain_length();
 //! Gets device ID for specified chip in the chain
 uint32_t jtag_get_device_id(int chip);
+//! Scan the chain and cache its IDCODEs and IR lengths
+uint8_t jtag_chain_scan();
+//! Find the shortest stable TCK delay
+uint16_t jtag_autotune(uint8_t iterations, uint16_t slowest);
+//! Repeatedly capture the boundary register, streaming the changes
+void jtag_bscan_capture(uint8_t app, uint8_t verb, uint32_t len);
+//! Aim later IR/DR shifts at one TAP, padding the rest with BYPASS
+int jtag_chain_select(uint8_t dev);
 
 //Pins.  Both SPI and JTAG names are acceptable.
 //#define SS   BIT0
@@ -114,6 +136,22 @@ uint32_t jtag_get_device_id(int chip);
 #define JTAGSPEED 20
 #define JTAGDELAY(x) delay(x)
 
+//! Extra delay() count in each TCK half period, 0 for full speed
+extern uint16_t jtag_tck_delay;
+#define TCKWAIT do { if (jtag_tck_delay) delay(jtag_tck_delay); } while (0)
+
+//Auto-tune defaults: reads per candidate delay, and the slowest delay tried
+#define JTAG_TUNE_ITERATIONS 8
+#define JTAG_TUNE_SLOWEST 0x400
+//Pattern shifted through the BYPASS chain while tuning
+#define JTAG_TUNE_PATTERN 0x4e85b2e6L
+
+//! Longest boundary register the capture mode takes.  A worst-case
+//  sample, 1+2*JTAG_BSCAN_MAXBITS/8 bytes, must fit in CMDDATALEN.
+#ifndef JTAG_BSCAN_MAXBITS
+#define JTAG_BSCAN_MAXBITS 1024
+#endif
+
 
 #define SETMOSI SPIOUT|=MOSI
 #define CLRMOSI SPIOUT&=~MOSI
@@ -148,6 +186,12 @@ extern int savedtclk;
 #define JTAG_DETECT_CHAIN_LENGTH 0x85
 #define JTAG_GET_DEVICE_ID 0x86
 #define JTAG_DR_SHIFT_MORE 0x87 // used for shiftings > 32bits.  assumes JTAG_DR_SHIFT with NOEND first
+#define JTAG_CHAIN_SCAN 0x8A
+#define JTAG_CHAIN_SELECT 0x8B
+#define JTAG_CHAIN_SET_IRLEN 0x8C
+#define JTAG_SET_TCK_DELAY 0xA9 // also in the sbw and openocd apps, clear of the ARM7 verbs
+#define JTAG_AUTOTUNE 0xAA
+#define JTAG_BSCAN_CAPTURE 0xAB
 //#define JTAG_DR_SHIFT20 0x91
 
 extern app_t const jtag_app;
@@ -85,6 +85,11 @@ unsigned int jtag430x2_por();
 //! Power-On Reset
 void jtag430_por();
 
+//! PROFILE histogram buckets, after the outside and asleep counts.
+#define JTAG430_PROFILE_BUCKETS ((CMDDATALEN>>1)-2)
+//! Take a running CPU and read the address of its next instruction.
+unsigned long jtag430_samplepc();
+
 
 //JTAG430 commands
 #define JTAG430_HALTCPU 0xA0
@@ -93,6 +98,7 @@ void jtag430_por();
 #define JTAG430_SETPC 0xC2
 #define JTAG430_SETREG 0xD2
 #define JTAG430_GETREG 0xD3
+#define JTAG430_PROFILE 0xD4
 
 #define JTAG430_WRITEMEM 0xE0
 #define JTAG430_WRITEFLASH 0xE1
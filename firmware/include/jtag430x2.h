@@ -15,5 +15,21 @@ extern app_t const jtag430x2_app;
 //! Shift 20 bits of the DR.
 uint32_t jtag430_dr_shift_20(uint32_t in);
 
+//! Set the 20-bit program counter of an MSP430X2.
+void jtag430x2_setpc(unsigned long adr);
+//! Release an MSP430X2 to run from its program counter.
+void jtag430x2_releasecpu();
+
+// JTAG430X2 block commands, which also work on MSP430X parts
+//! Stream words from a list of [start, end) regions.
+#define JTAG430X2_READBLOCK 0xE9
+//! Write a run of words to RAM.
+#define JTAG430X2_WRITEBLOCK 0xEA
+//! Run a funclet from RAM, then return its mailbox word.
+#define JTAG430X2_FUNCLET 0xEB
+
+//! Bytes per READBLOCK reply packet.
+#define JTAG430X2_BLOCKSIZE 0x400
+
 #endif
 
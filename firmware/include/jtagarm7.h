@@ -40,6 +40,21 @@ void jtagarm7tdmi_set_register(unsigned long reg, unsigned long val);
 //!  Get a 32-bit ARM register
 unsigned long jtagarm7tdmi_get_register(unsigned long reg);
 
+//!  Capture r0-r15 and CPSR into regs[ARM_CONTEXT_REGS]
+void jtagarm7_get_registers(unsigned long *regs);
+//!  Restore r0-r14 from regs[], and CPSR too if restore_cpsr is set
+void jtagarm7_set_registers(unsigned long *regs, unsigned char restore_cpsr);
+
+//!  Read a block of 32-bit words with LDMIA, streaming them to the host
+void jtagarm7_readmem_block(uint8_t app, uint8_t verb, unsigned long adr, unsigned int count);
+//!  Write a block of 32-bit words with STMIA
+unsigned int jtagarm7_writemem_block(unsigned long adr, const unsigned long *data, unsigned int count);
+//!  Stream words through the debug comms channel to the download stub
+unsigned int jtagarm7_dcc_write(const unsigned long *data, unsigned int count);
+
+//!  Arm watchpoint 0 and log the accesses it catches into the trace ring
+unsigned int jtagarm7_trace_run(unsigned int hits, unsigned int timeout, unsigned long *pc);
+
 //!  Shift an arbitrary number of bits, using an array of uchars
 uint8_t* jtag_trans_many(uint8_t *word, uint8_t bitcount, enum eTransFlags flags);
 
@@ -116,6 +131,16 @@ The least significant bit of the instruction register is scanned in and scanned
 #define JTAGARM7_SCANCHAIN1                 0x94
 #define JTAGARM7_EICE_READ                  0x95
 #define JTAGARM7_EICE_WRITE                 0x96
+#define JTAGARM7_READ_BLOCK                 0x97
+#define JTAGARM7_WRITE_BLOCK                0x98
+#define JTAGARM7_GET_REGISTERS              0x99
+#define JTAGARM7_SET_REGISTERS              0x9a
+#define JTAGARM7_DCC_LOAD_STUB              0xa0
+#define JTAGARM7_DCC_WRITE                  0xa1
+#define JTAGARM7_TRACE_START                0xa2
+#define JTAGARM7_TRACE_RUN                  0xa3
+#define JTAGARM7_TRACE_READ                 0xa4
+#define JTAGARM7_TRACE_STOP                 0xa5
 #define JTAGARM7_IR_SIZE                    0x9f
 #define JTAGARM7_SCAN_N_SIZE                0x9e
 
@@ -139,8 +164,16 @@ The least significant bit of the instruction register is scanned in and scanned
 #define ARM_INSTR_MSR_cpsr_cxsf_R0  0xe12ff000L
 #define ARM_INSTR_STMIA_R14_r0_rx   0xE88E0000L      // add up to 65k to indicate which registers...
 #define ARM_STORE_MULTIPLE          ARM_INSTR_STMIA_R14_r0_rx
+#define ARM_INSTR_LDMIA_R14_r0_rx   0xE89E0000L      // add up to 65k to indicate which registers...
+#define ARM_LOAD_MULTIPLE           ARM_INSTR_LDMIA_R14_r0_rx
+#define ARM_MULTIPLE_MAXREGS        14               // r0-r13, r14 holds the address
+#define ARM_READ_BLOCK_MAX          0x3FFF           // longest block read, keeping the reply within a 16-bit length
 #define ARM_INSTR_SKANKREGS         0xE88F7fffL
 #define ARM_INSTR_CLOBBEREGS        0xE89F7fffL
+#define ARM_INSTR_STMIA_PC_r0_rx    0xE88F0000L      // debug-speed STM, register values appear on the data bus
+#define ARM_INSTR_LDMIA_PC_r0_rx    0xE89F0000L      // debug-speed LDM, register values are fed in on the data bus
+#define ARM_REG_CPSR                16               // index of CPSR in a register context
+#define ARM_CONTEXT_REGS            17               // r0-r15, CPSR
 
 #define ARM_INSTR_B_IMM             0xea000000L
 #define ARM_INSTR_BX_PC             0xe12fff10L      // need to set r0 to the desired address
@@ -158,6 +191,21 @@ The least significant bit of the instruction register is scanned in and scanned
 #define THUMB_SWAP_LoHi             1
 #define ARM_REG_PC                  15
 
+// EmbeddedICE watchpoint control bits
+#define EICE_WPCTRL_nRW             0x001
+#define EICE_WPCTRL_nOPC            0x008
+#define EICE_WPCTRL_ENABLE          0x100
+
+//! Records in the watchpoint trace ring, a power of two.
+#define JTAGARM7_TRACE_DEPTH        32
+
+//! One watchpoint hit: resume PC, then address and data buses from chain 0.
+typedef struct {
+  unsigned long pc;
+  unsigned long adr;
+  unsigned long data;
+} jtagarm7_trace_t;
+
 #define JTAG_ARM7TDMI_DBG_DBGACK    1
 #define JTAG_ARM7TDMI_DBG_DBGRQ     2
 #define JTAG_ARM7TDMI_DBG_IFEN      4
@@ -48,10 +48,72 @@
  * system functions when this instruction is selected. */
 #define XSCALE_IR_BYPASS			0x1F
 
+/* The debug instructions below have the same values in the 5 and 7-bit 
+ * IRs, with BYPASS being all ones in both. */
+
+/* 01001 - Select DCSR
+ * Connects a 36-bit register: 3 bits of hold_rst/ext_dbg_break control, the 
+ * 32-bit Debug Control and Status Register, and a trailing bit. */
+#define XSCALE_IR_SELDCSR			0x09
+
+/* 10000 - DBGTX
+ * Reads the TX register, which the debug handler writes.  Bit 0 of the 
+ * capture is TX_READY.  Going straight from Capture-DR to Shift-DR 
+ * consumes the value. */
+#define XSCALE_IR_DBGTX				0x10
+
+/* 00010 - DBGRX
+ * Writes the RX register, which the debug handler reads.  Bit 0 of the 
+ * capture is RR, set while the handler has yet to read the last word, and 
+ * the trailing bit flags the new word valid. */
+#define XSCALE_IR_DBGRX				0x02
+
+/* 00111 - LDIC
+ * Loads or invalidates instruction cache lines.  A 6-bit function and the 
+ * 27-bit line address are followed by eight 32-bit words, each with an even 
+ * parity bit. */
+#define XSCALE_IR_LDIC				0x07
+
+/* LDIC functions */
+#define XSCALE_LDIC_INVALIDATE_IC_LINE	0x00
+#define XSCALE_LDIC_INVALIDATE_MINI_IC	0x01
+#define XSCALE_LDIC_LOAD_MAIN_IC		0x02
+#define XSCALE_LDIC_LOAD_MINI_IC		0x03
+
+/* Control bits of the SELDCSR scan */
+#define XSCALE_DCSR_HOLD_RST		0x02
+#define XSCALE_DCSR_EXT_DBG_BREAK	0x04
+
+/* DCSR bits */
+#define XSCALE_DCSR_GE				0x80000000L	/* global enable */
+#define XSCALE_DCSR_H				0x40000000L	/* halt mode */
+#define XSCALE_DCSR_TR				0x00010000L	/* trap reset */
+#define XSCALE_DCSR_SA				0x00000020L	/* sticky abort */
+
+/* Debug handler commands, as in OpenOCD's XScale debug handler.  The low 
+ * nibble is the access size in bytes. */
+#define XSCALE_HANDLER_READ			0x10
+#define XSCALE_HANDLER_WRITE		0x20
+
+/* Polls of TX_READY or RR before giving up on the handler */
+#define XSCALE_POLL_RETRIES			0x1000
+
+/* Longest block read, keeping the reply within a 16-bit length */
+#define XSCALE_READ_MAX				0x3FF0
+
+/* Cache lines per XSCALE_LOAD_IC, fitting the smallest cmddata buffer */
+#define XSCALE_LOAD_IC_LINES		7
+
 /*
  * GoodFET Commands from the Client
  */
 /* commands start at 0xF0 */
+#define XSCALE_DCSR				0xF0
+#define XSCALE_LOAD_IC			0xF1
+#define XSCALE_DBGRX			0xF2
+#define XSCALE_DBGTX			0xF3
+#define XSCALE_READ_BLOCK		0xF4
+#define XSCALE_WRITE_BLOCK		0xF5
 
 
 /*
@@ -65,6 +127,19 @@ unsigned long jtag_xscale_shift_n(unsigned long word,
                                   unsigned char nbits,
                                   unsigned char flags);
 
+/* scan the DCSR, returning the captured value */
+unsigned long jtag_xscale_dcsr(unsigned long dcsr, unsigned char ctrl);
+
+/* load cache lines into the mini ICache */
+unsigned int jtag_xscale_load_ic(unsigned long va, unsigned int lines,
+                                 unsigned char invalidate, unsigned char *data);
+
+/* send a word to the debug handler, returning 0 on success */
+unsigned char jtag_xscale_write_rx(unsigned long word);
+
+/* receive a word from the debug handler, returning 0 on success */
+unsigned char jtag_xscale_read_tx(unsigned long *word);
+
 extern app_t const jtagxscale_app;
 
 #endif // JTAGXSCALE_H
@@ -16,6 +16,7 @@
 #define OPENOCD_READ	0x81
 #define OPENOCD_WRITE	0x82
 #define OPENOCD_LED		0x83
+#define OPENOCD_SCAN	0x84
 
 extern app_t const openocd_app;
 
@@ -61,12 +61,14 @@ void sbwSETTCLK();
 void sbwCLRTCLK();
 
 // Macros
+//Only the high phase is stretched, as SBWTCK low for 7us leaves SBW.
 #define SBWCLK() do { \
     SPIOUT &= ~SBWTCK; \
     asm("nop");	      \
     asm("nop");	      \
     asm("nop");	      \
     SPIOUT |= SBWTCK;  \
+    TCKWAIT;	      \
   } while (0)
 #define SETSBWIO(x) do { 			\
   if (x)					\
@@ -0,0 +1,62 @@
+/*! \file swd.h
+  \brief ARM Serial Wire Debug (SW-DP)
+*/
+
+#ifndef SWD_H
+#define SWD_H
+
+#include "app.h"
+
+#define SWD 0x19
+
+// SWDIO on TMS, SWCLK on TCK, as on the ARM 20-pin connector
+#define SWDIO  BIT0
+#define SWCLK  BIT3
+
+#define SWDIO_DRIVE   SPIDIR|=SWDIO
+#define SWDIO_RELEASE SPIDIR&=~SWDIO
+#define SWD_READ      (SPIIN&SWDIO?1:0)
+
+/* Requests are packed one byte each, as the low nibble of the SWD
+   packet request:  APnDP[0], RnW[1], A[3:2] in [3:2].  Writes are
+   followed by their 32-bit little endian data. */
+#define SWD_REQ_APnDP  0x01
+#define SWD_REQ_RnW    0x02
+#define SWD_REQ_A32    0x0C
+
+#define SWD_REQ_AP_READ   (SWD_REQ_APnDP|SWD_REQ_RnW)
+#define SWD_REQ_RDBUFF    (SWD_REQ_RnW|0x0C)
+#define SWD_REQ_IDCODE    (SWD_REQ_RnW|0x00)
+#define SWD_REQ_ABORT     0x00
+
+// ACK, LSB first on the wire
+#define SWD_ACK_OK      0x1
+#define SWD_ACK_WAIT    0x2
+#define SWD_ACK_FAULT   0x4
+// not on the wire, read data failed its parity check
+#define SWD_ACK_PARITY  0x8
+
+//ABORT: clear STICKYERR, STICKYCMP, WDATAERR and STICKYORUN
+#define SWD_ABORT_CLEAR 0x1EL
+
+//Number of WAIT responses to retry before giving up
+#define SWD_WAIT_RETRIES 0x100
+//Idle cycles after each transfer, letting posted AP writes complete
+#define SWD_IDLE_CYCLES  8
+
+// SWD Commands
+#define SWD_LINE_RESET  0x90
+#define SWD_TRANSFER    0x91
+
+//! Drive SWCLK and SWDIO.
+void swd_setup(void);
+//! Line reset, switching the DP from JTAG to SWD.
+void swd_line_reset(void);
+//! One SWD transfer, retried on WAIT, with sticky errors cleared on FAULT.  Returns the ACK.
+unsigned char swd_xfer(unsigned char req, unsigned long *data);
+//! Run a packed list of transfers, streaming the read results.
+void swd_transfer(uint8_t app, uint8_t verb, unsigned int len);
+
+extern app_t const swd_app;
+
+#endif // SWD_H
@@ -0,0 +1,60 @@
+/*! \file xsvf.h
+  \brief XSVF player, fed from a streamed payload
+*/
+
+#ifndef XSVF_H
+#define XSVF_H
+
+#include "app.h"
+
+#define XSVF 0x1A
+
+//! Longest XSDRSIZE/XSIR vector, in bits.
+#ifndef XSVF_MAXBITS
+#define XSVF_MAXBITS 2048
+#endif
+#define XSVF_MAXBYTES ((XSVF_MAXBITS+7)/8)
+
+// XSVF instructions, from Xilinx XAPP503
+#define XCOMPLETE     0x00
+#define XTDOMASK      0x01
+#define XSIR          0x02
+#define XSDR          0x03
+#define XRUNTEST      0x04
+#define XREPEAT       0x07
+#define XSDRSIZE      0x08
+#define XSDRTDO       0x09
+#define XSETSDRMASKS  0x0A
+#define XSDRINC       0x0B
+#define XSDRB         0x0C
+#define XSDRC         0x0D
+#define XSDRE         0x0E
+#define XSDRTDOB      0x0F
+#define XSDRTDOC      0x10
+#define XSDRTDOE      0x11
+#define XSTATE        0x12
+#define XENDIR        0x13
+#define XENDDR        0x14
+#define XSIR2         0x15
+#define XCOMMENT      0x16
+#define XWAIT         0x17
+
+// Player status
+#define XSVF_RUNNING          0x00
+#define XSVF_COMPLETE         0x01
+#define XSVF_ERROR_MISMATCH   0x02
+#define XSVF_ERROR_ILLEGALCMD 0x03
+#define XSVF_ERROR_TOOBIG     0x04
+
+// XSVF Commands
+#define XSVF_DATA     0x90
+#define XSVF_STATUS   0x91
+
+//! Reset the player and the TAP.
+void xsvf_start(void);
+//! Run a chunk of the XSVF stream.  Returns the player status.
+unsigned char xsvf_feed(const unsigned char *data, unsigned int len);
+
+extern app_t const xsvf_app;
+
+#endif // XSVF_H
@@ -0,0 +1,36 @@
+#include <cc1110.h>
+#include "cc1110-ext.h"
+
+/* Input at 0xFE00 is the first page, the page count and the page
+   size in 256-byte blocks.  Output from 0xFE04 is each page's CRC16,
+   low byte first. */
+char __xdata at 0xfe00 packet[256] ;
+
+//! CRC16 a run of flash pages with the RNG's CRC unit.
+void main(){
+  unsigned char page=packet[0], count=packet[1], blocks=packet[2];
+  unsigned char i=4, b, n;
+  __code unsigned char *p;
+
+  //Keep the LFSR running, so writes to RNDH shift into it.
+  ADCCON1 &= ~0x0C;
+
+  while(count--){
+    p=(__code unsigned char*) (((unsigned int) (page++*blocks))<<8);
+
+    //Two writes to RNDL seed the CRC.
+    RNDL=0xFF;
+    RNDL=0xFF;
+    b=blocks;
+    do{
+      n=0;
+      do{
+	RNDH=*p++;
+      }while(--n);
+    }while(--b);
+
+    packet[i++]=RNDL;
+    packet[i++]=RNDH;
+  }
+  HALT;
+}
@@ -0,0 +1,124 @@
+#include <cc1110.h>
+#include "cc1110-ext.h"
+
+/* Receives packets by DMA into a ring of slots in XDATA, for the host
+   to drain in bulk while the radio keeps listening.
+
+   The host owns tail, and this code owns head and drops.  A slot is
+   four bytes of sleep-timer timestamp (ST2:ST0, then a pad), followed
+   by the packet as rxpacket.c leaves it: length, payload, RSSI and
+   LQI.  When the ring is full, packets are still received, into a
+   scratch slot, and counted in drops.
+*/
+
+#define RING_MAGIC 0xB5
+#define SLOTS 32
+#define SLOTLEN 64
+#define X_RFD 0xDFD9
+
+typedef struct {
+  unsigned char magic;
+  unsigned char head;
+  unsigned char tail;
+  unsigned char slots;
+  unsigned char slotlen;
+  unsigned char pad;
+  unsigned int drops;
+  unsigned char desc[8];
+} ring_header;
+
+__xdata __at 0xf400 ring_header ring;
+__xdata __at 0xf410 unsigned char slots[SLOTS][SLOTLEN];
+__xdata __at 0xfe00 unsigned char scratch[SLOTLEN];
+
+//! Arm DMA channel 0 to copy the next packet from RFD to dst.
+void arm(__xdata unsigned char *dst){
+  unsigned int adr=(unsigned int) dst;
+
+  if(PKTCTRL0&1){
+    //Length byte, payload and two status bytes: VLEN=n+3.
+    ring.desc[2]=adr>>8;
+    ring.desc[3]=adr&0xFF;
+    ring.desc[4]=0x80;
+    ring.desc[5]=SLOTLEN-4;
+  }else{
+    //Fixed length, so write the length byte ourselves.
+    *dst=PKTLEN;
+    adr++;
+    ring.desc[2]=adr>>8;
+    ring.desc[3]=adr&0xFF;
+    ring.desc[4]=0x00;
+    ring.desc[5]=PKTLEN+2;
+  }
+  DMAARM|=DMAARM0;
+}
+
+//! Receive into the ring forever.
+void main(){
+  __xdata unsigned char *slot;
+  unsigned char next;
+
+  //Disable interrupts.
+  RFTXRXIE=0;
+
+  //Status appended, and straight back to RX after each packet.
+  PKTCTRL1|=PKTCTRL1_APPEND_STATUS;
+  MCSM1=(MCSM1&~MCSM1_RXOFF_MODE)|MCSM1_RXOFF_MODE_RX;
+
+  ring.head=0;
+  ring.tail=0;
+  ring.slots=SLOTS;
+  ring.slotlen=SLOTLEN;
+  ring.drops=0;
+
+  //RFD to memory on the RADIO trigger, high priority.  IRQMASK is
+  //set so that DMAIF0 flags the end of each packet.
+  ring.desc[0]=X_RFD>>8;
+  ring.desc[1]=X_RFD&0xFF;
+  ring.desc[6]=19;
+  ring.desc[7]=0x1A;
+  DMA0CFGH=((unsigned int) ring.desc)>>8;
+  DMA0CFGL=((unsigned int) ring.desc)&0xFF;
+  ring.magic=RING_MAGIC;
+
+  RFST=RFST_SIDLE;
+  while(MARCSTATE!=MARC_STATE_IDLE);
+
+  while(1){
+    next=ring.head+1;
+    if(next==SLOTS)
+      next=0;
+    if(next==ring.tail)
+      slot=scratch;
+    else
+      slot=slots[ring.head];
+
+    DMAIRQ&=~DMAIRQ_DMAIF0;
+    arm(slot+4);
+    RFST=RFST_SRX;
+
+    while(!(DMAIRQ&DMAIRQ_DMAIF0)){
+      //Recover from an overflow rather than hang.
+      if(MARCSTATE==MARC_STATE_RX_OVERFLOW){
+	DMAARM=DMAARM_ABORT|DMAARM0;
+	RFST=RFST_SIDLE;
+	while(MARCSTATE!=MARC_STATE_IDLE);
+	ring.drops++;
+	DMAIRQ&=~DMAIRQ_DMAIF0;
+	arm(slot+4);
+	RFST=RFST_SRX;
+      }
+    }
+
+    //ST0 must be read first, as it latches the rest.
+    slot[0]=ST0;
+    slot[1]=ST1;
+    slot[2]=ST2;
+    slot[3]=0;
+
+    if(slot==scratch)
+      ring.drops++;
+    else
+      ring.head=next;
+  }
+}
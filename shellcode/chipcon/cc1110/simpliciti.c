@@ -0,0 +1,136 @@
+#include <cc1110.h>
+#include "cc1110-ext.h"
+
+/* A SimpliciTI access point's LINK and JOIN replies, answered on the
+   target so that they land inside the protocol's timing window.
+
+   The host writes its address and tokens to 0xFE00 before starting.
+   Every good packet received, answered or not, is also kept in the
+   same ring as rxring.c, for the host to drain.
+*/
+
+#define RING_MAGIC 0xB5
+#define SLOTS 32
+#define SLOTLEN 64
+
+#define PORT_LINK 0x02
+#define PORT_JOIN 0x03
+
+typedef struct {
+  unsigned char magic;
+  unsigned char head;
+  unsigned char tail;
+  unsigned char slots;
+  unsigned char slotlen;
+  unsigned char pad;
+  unsigned int drops;
+  unsigned char desc[8];
+} ring_header;
+
+typedef struct {
+  unsigned char addr[4];
+  unsigned char linktoken[4];
+  unsigned char jointoken[4];
+} ap_config;
+
+__xdata __at 0xf400 ring_header ring;
+__xdata __at 0xf410 unsigned char slots[SLOTS][SLOTLEN];
+__xdata __at 0xfe00 ap_config config;
+__xdata __at 0xfe40 unsigned char rx[SLOTLEN];
+__xdata __at 0xfe80 unsigned char tx[32];
+
+//! Receive a packet into rx[], as rxpacket.c does.
+void receive(){
+  unsigned char len=16, i=0;
+
+  RFST=RFST_SIDLE;
+  while(MARCSTATE!=MARC_STATE_IDLE);
+  RFST=RFST_SRX;
+  while(MARCSTATE!=MARC_STATE_RX);
+
+  while(i<len+3 && i<SLOTLEN){
+    while(!RFTXRXIF);
+    RFTXRXIF=0;
+    rx[i++]=RFD;
+    len=rx[0];
+  }
+  RFST=RFST_SIDLE;
+}
+
+//! Transmit tx[], as txpacket.c does.
+void transmit(){
+  unsigned char len=tx[0], i=0;
+
+  RFST=RFST_SIDLE;
+  while(MARCSTATE!=MARC_STATE_IDLE);
+  RFST=RFST_STX;
+  while(MARCSTATE!=MARC_STATE_TX);
+
+  while(i<len+1){
+    while(!RFTXRXIF);
+    RFTXRXIF=0;
+    RFD=tx[i++];
+  }
+  while(MARCSTATE==MARC_STATE_TX);
+}
+
+//! Answer a LINK or JOIN request with the given token.
+void reply(unsigned char len, __xdata unsigned char *token){
+  unsigned char i;
+
+  tx[0]=len;
+  for(i=0;i<4;i++){
+    tx[1+i]=rx[5+i];          //to the requester
+    tx[5+i]=config.addr[i];   //from us
+    tx[14+i]=token[i];
+  }
+  tx[9]=rx[9];                //port
+  tx[10]=0x21;
+  tx[11]=rx[11];              //seq
+  tx[12]=0x81;                //reply
+  tx[13]=rx[13];              //tid
+  tx[18]=0x00;                //no security
+  transmit();
+}
+
+//! Answer requests and log packets forever.
+void main(){
+  unsigned char i, next, len;
+
+  //Disable interrupts.
+  RFTXRXIE=0;
+
+  ring.head=0;
+  ring.tail=0;
+  ring.slots=SLOTS;
+  ring.slotlen=SLOTLEN;
+  ring.drops=0;
+  ring.magic=RING_MAGIC;
+
+  while(1){
+    receive();
+    len=rx[0];
+    if(len<12 || len+3>SLOTLEN || !(rx[len+2]&0x80))
+      continue;  //short, or a bad CRC
+
+    if(rx[9]==PORT_LINK)
+      reply(0x10, config.linktoken);
+    else if(rx[9]==PORT_JOIN && rx[12]==1)
+      reply(0x12, config.jointoken);
+
+    next=ring.head+1;
+    if(next==SLOTS)
+      next=0;
+    if(next==ring.tail){
+      ring.drops++;
+      continue;
+    }
+    slots[ring.head][0]=ST0;
+    slots[ring.head][1]=ST1;
+    slots[ring.head][2]=ST2;
+    slots[ring.head][3]=0;
+    for(i=0;i<len+3;i++)
+      slots[ring.head][4+i]=rx[i];
+    ring.head=next;
+  }
+}
@@ -24,6 +24,7 @@
 
 /* globals */
 __xdata __at 0xff00 channel_info chan_table[NUM_CHANNELS];
+__xdata __at 0xfe00 sweep_table sweeps;
 u16 center_freq;
 u16 user_freq;
 u8 band;
@@ -120,6 +121,9 @@ void calibrate_freq(u32 freq, u8 ch) {
   chan_table[ch].fscal3 = FSCAL3;
   chan_table[ch].fscal2 = FSCAL2;
   chan_table[ch].fscal1 = FSCAL1;
+  sweeps.freq[ch][0] = FREQ2;
+  sweeps.freq[ch][1] = FREQ1;
+  sweeps.freq[ch][2] = FREQ0;
 
   /* get initial RSSI measurement */
   chan_table[ch].ss = (RSSI ^ 0x80);
@@ -349,7 +353,7 @@ void poll_keyboard() {
 }
 
 void main(void) {
-  u8 ch;
+  u8 ch, next;
   u16 i;
   
  reset:
@@ -370,9 +374,12 @@ void main(void) {
   radio_setup();
   set_width(WIDE);
 	
-  
+  sweeps.seq = 0;
+  sweeps.buf = 0;
+  sweeps.magic = SWEEP_MAGIC;
 
   while (1) {
+    next = sweeps.buf ^ 1;
     for (ch = min_chan; ch < max_chan; ch++) {
       /* tune radio and start RX */
       tune(ch);
@@ -392,14 +399,19 @@ void main(void) {
 				 chan_table[ch].max);
       else
 	chan_table[ch].max = 0;
+      sweeps.ss[next][ch] = chan_table[ch].ss;
 
       /* end RX */
       RFST = RFST_SIDLE;
     }
 
+    /* publish the sweep, then keep scanning; the host reads while halted */
+    sweeps.min_chan = min_chan;
+    sweeps.max_chan = max_chan;
+    sweeps.buf = next;
+    sweeps.seq++;
+
     //poll_keyboard();
-    chan_table[0].ss=0x00;
-    HALT;
 
     if (user_freq != center_freq)
       user_freq = set_center_freq(user_freq);
@@ -106,6 +106,26 @@ typedef struct {
 	u8 max;
 } channel_info;
 
+/*
+ * Completed sweeps are published here for the host, double buffered.  ss[buf]
+ * holds sweep number seq, and is left alone while the next sweep fills
+ * ss[buf ^ 1], so a halted CPU never leaves the host a torn sweep.
+ */
+#define SWEEP_MAGIC 0x5A
+
+typedef struct {
+	u8 magic;
+	u8 seq;
+	u8 buf;
+	u8 min_chan;
+	u8 max_chan;
+
+	/* FREQ2, FREQ1, FREQ0 of each channel */
+	u8 freq[NUM_CHANNELS][3];
+
+	u8 ss[2][NUM_CHANNELS];
+} sweep_table;
+
 void clear();
 void plot(u8 col);
 void putchar(char c);